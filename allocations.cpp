@@ -0,0 +1,34 @@
+#include "allocations.h"
+#include <QtCore>
+#include <stdlib.h>
+#include <new>
+
+static QAtomicInt allocations;
+
+int allocationCount()
+{
+    return allocations;
+}
+
+void *operator new(size_t size) throw(std::bad_alloc)
+{
+    allocations.ref();
+    if (void *ptr = malloc(size ? size : 1))
+        return ptr;
+    throw std::bad_alloc();
+}
+
+void *operator new[](size_t size) throw(std::bad_alloc)
+{
+    return operator new(size);
+}
+
+void operator delete(void *ptr) throw()
+{
+    free(ptr);
+}
+
+void operator delete[](void *ptr) throw()
+{
+    free(ptr);
+}
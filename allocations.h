@@ -0,0 +1,9 @@
+#ifndef ALLOCATIONS_H
+#define ALLOCATIONS_H
+
+// Linking allocations.cpp into a program replaces the global operator new
+// with one that counts every allocation in the process, for benchmarks
+// that report allocations per operation. Not for the game itself.
+int allocationCount();
+
+#endif
@@ -0,0 +1,11 @@
+#include "arguments.h"
+
+QString argumentValue(const QStringList &args, const QString &name, const QString &defaultValue)
+{
+    const QString prefix = QString("--%1=").arg(name);
+    foreach(const QString &arg, args) {
+        if (arg.startsWith(prefix))
+            return arg.mid(prefix.size());
+    }
+    return defaultValue;
+}
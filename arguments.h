@@ -0,0 +1,9 @@
+#ifndef ARGUMENTS_H
+#define ARGUMENTS_H
+
+#include <QtCore>
+
+// The value of --name=value in args, defaultValue when it isn't there
+QString argumentValue(const QStringList &args, const QString &name, const QString &defaultValue = QString());
+
+#endif
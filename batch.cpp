@@ -0,0 +1,105 @@
+#include <QtCore>
+#include <stdio.h>
+#include "batch.h"
+#include "gameloader.h"
+#include "binarygame.h"
+#include "random.h"
+
+struct BoardWriter
+{
+    typedef QString result_type;
+
+    BoardWriter(const QString &program, const QString &pattern, bool binary, quint64 seed)
+        : program(program), pattern(pattern), binary(binary), seed(seed)
+    {}
+
+    // Returns an error or an empty string
+    QString operator()(int board) const
+    {
+        GameData game;
+        QString error;
+        // --generate=1 --seed=S regenerates the board that had seed S
+        const quint64 boardSeed = seed + board - 1;
+        if (!JavaScriptGameLoader::evaluate(program, boardSeed, &game, &error) || !generateFrames(&game, &error))
+            return QString("Board %1: %2").arg(board).arg(error);
+        QFile file(pattern.arg(board, 5, 10, QLatin1Char('0')));
+        if (!file.open(QIODevice::WriteOnly|QIODevice::Truncate))
+            return QString("Can't open %1 for writing").arg(file.fileName());
+        if (!binary)
+            file.write("# Generated with --seed=" + QByteArray::number(boardSeed) + '\n');
+        const bool ok = (binary
+                         ? BinaryGameLoader::write(&file, game, &error)
+                         : TextGameLoader::write(&file, game, &error));
+        if (!ok) {
+            file.remove();
+            return QString("Can't write %1: %2").arg(file.fileName(), error);
+        }
+        return QString();
+    }
+
+    const QString program, pattern;
+    const bool binary;
+    const quint64 seed;
+};
+
+int generateBoards(int argc, char **argv)
+{
+    QCoreApplication a(argc, argv);
+    int count = 0;
+    int threads = QThread::idealThreadCount();
+    QString format = QLatin1String("jgmb");
+    QString output = QLatin1String(".");
+    QString input;
+    foreach(const QString &arg, a.arguments().mid(1)) {
+        if (arg.startsWith("--generate=")) {
+            count = arg.mid(11).toInt();
+        } else if (arg.startsWith("--format=")) {
+            format = arg.mid(9);
+        } else if (arg.startsWith("--output=")) {
+            output = arg.mid(9);
+        } else if (arg.startsWith("--threads=")) {
+            threads = arg.mid(10).toInt();
+        } else if (!arg.startsWith("--")) {
+            input = arg;
+        }
+    }
+    if (count <= 0 || threads <= 0 || input.isEmpty() || (format != "jgm" && format != "jgmb")) {
+        fprintf(stderr, "Usage: %s --generate=N [--format=jgm|jgmb] [--output=dir] [--threads=N] [--seed=S] game.js\n", argv[0]);
+        return 1;
+    }
+
+    QFile file(input);
+    if (!file.open(QIODevice::ReadOnly)) {
+        fprintf(stderr, "Can't open %s for reading\n", qPrintable(input));
+        return 1;
+    }
+    const QString program = QTextStream(&file).readAll();
+    if (!QDir().mkpath(output)) {
+        fprintf(stderr, "Can't create %s\n", qPrintable(output));
+        return 1;
+    }
+    const QString pattern = QDir(output).filePath(QFileInfo(input).completeBaseName() + "-%1." + format);
+
+    QList<int> boards;
+    boards.reserve(count);
+    for (int i=0; i<count; ++i)
+        boards.append(i + 1);
+
+    const quint64 seed = Random::nextSeed();
+    QThreadPool::globalInstance()->setMaxThreadCount(threads);
+    QElapsedTimer timer;
+    timer.start();
+    const QStringList errors = QtConcurrent::blockingMapped<QStringList>(boards, BoardWriter(program, pattern, format == "jgmb", seed));
+    const qint64 elapsed = timer.elapsed();
+
+    int failed = 0;
+    foreach(const QString &error, errors) {
+        if (!error.isEmpty()) {
+            fprintf(stderr, "%s\n", qPrintable(error));
+            ++failed;
+        }
+    }
+    printf("Wrote %d of %d boards to %s in %lldms using %d threads. Board n has seed %llu + n - 1\n",
+           count - failed, count, qPrintable(QDir(output).path()), elapsed, threads, seed);
+    return failed ? 1 : 0;
+}
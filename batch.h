@@ -0,0 +1,11 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+// jeopardy --generate=N [--format=jgm|jgmb] [--output=dir] [--threads=N] [--seed=S] game.js
+//
+// Evaluates a script game N times without any windows and writes each
+// board to its own file. Boards are spread over the thread pool and every
+// worker thread has its own script engine.
+int generateBoards(int argc, char **argv);
+
+#endif
@@ -0,0 +1,21 @@
+TEMPLATE = app
+TARGET =
+DEPENDPATH += . ..
+INCLUDEPATH += . ..
+
+# Input
+HEADERS += ../scene.h ../items.h ../stats.h ../gameparser.h ../gameloader.h ../binarygame.h ../random.h ../gamemodel.h ../stateengine.h ../allocations.h ../arguments.h
+SOURCES += main.cpp ../scene.cpp ../items.cpp ../stats.cpp ../gameparser.cpp ../gameloader.cpp ../binarygame.cpp ../random.cpp ../gamemodel.cpp ../stateengine.cpp ../allocations.cpp ../arguments.cpp
+CONFIG += debug
+unix {
+    MOC_DIR=.moc
+    UI_DIR=.ui
+    OBJECTS_DIR=.obj
+} else {
+    MOC_DIR=tmp/moc
+    UI_DIR=tmp/ui
+    OBJECTS_DIR=tmp/obj
+}
+RESOURCES += ../jeopardy.qrc
+QT = script gui core
+CONFIG -= app_bundle
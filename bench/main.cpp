@@ -0,0 +1,323 @@
+#include <QtGui>
+#include <stdio.h>
+#include "items.h"
+#include "gameparser.h"
+#include "scene.h"
+#include "stateengine.h"
+#include "allocations.h"
+
+// The fitting loop Item::paint used before initTextLayout learned to
+// bisect. Kept here so the numbers can be compared.
+static int linearInitTextLayout(QTextLayout *layout, const QRectF &rect, const QFont &font, int *layouts)
+{
+    int pixelSize = rect.height() / 5;
+    int used = pixelSize;
+    int count = 0;
+    layout->setCacheEnabled(true);
+    QTextOption option;
+    option.setAlignment(Qt::AlignCenter);
+    layout->setTextOption(option);
+    forever {
+        ++count;
+        layout->clearLayout();
+        QFont f(font);
+        f.setPixelSize(used = pixelSize--);
+        layout->setFont(f);
+        layout->beginLayout();
+        const int h = QFontMetrics(f).height();
+        QPointF pos(rect.topLeft());
+        forever {
+            QTextLine line = layout->createLine();
+            if (!line.isValid())
+                break;
+            line.setLineWidth(rect.width());
+            line.setPosition(pos);
+            pos += QPointF(0, h);
+        }
+        layout->endLayout();
+        const QRectF textRect = layout->boundingRect();
+        if (pixelSize <= 8 || rect.size().expandedTo(textRect.size()) == rect.size()) {
+            break;
+        }
+    }
+    *layouts = count;
+    return used;
+}
+
+static QStringList benchmarkTexts()
+{
+    QStringList texts;
+    texts << QLatin1String("Nitobe Inazo (up to 2004) / Ichiyo Higuchi (from late 2004)");
+    QFile file(":/questions.txt");
+    if (file.open(QIODevice::ReadOnly)) {
+        QTextStream ts(&file);
+        while (!ts.atEnd()) {
+            const QStringList split = ts.readLine().simplified().split('|');
+            if (split.size() == 2)
+                texts << split;
+        }
+    }
+    return texts;
+}
+
+typedef int (*FitFunction)(QTextLayout *, const QRectF &, const QFont &, int *);
+
+static void benchmarkLayout(int iterations)
+{
+    const QStringList texts = benchmarkTexts();
+    // A cell and the raised question of a 6x6 board on a 1920x1080 projector
+    const QSizeF sizes[] = { QSizeF(310, 153), QSizeF(1526, 774) };
+    const char *names[] = { "linear", "bisect" };
+    const FitFunction functions[] = { linearInitTextLayout, initTextLayout };
+    const QFont font;
+
+    printf("%-8s %-12s %10s %10s %10s %12s\n", "search", "size", "fits", "layouts", "per fit", "usecs/fit");
+    for (unsigned s=0; s<sizeof(sizes) / sizeof(sizes[0]); ++s) {
+        const QRectF rect(QPointF(), sizes[s]);
+        for (int f=0; f<2; ++f) {
+            int fits = 0;
+            qint64 layouts = 0;
+            QElapsedTimer timer;
+            timer.start();
+            for (int i=0; i<iterations; ++i) {
+                foreach(const QString &text, texts) {
+                    QTextLayout layout(text);
+                    int count = 0;
+                    functions[f](&layout, rect, font, &count);
+                    layouts += count;
+                    ++fits;
+                }
+            }
+            const qint64 elapsed = timer.nsecsElapsed();
+            printf("%-8s %5dx%-6d %10d %10lld %10.2f %12.2f\n", names[f],
+                   int(sizes[s].width()), int(sizes[s].height()), fits, layouts,
+                   double(layouts) / fits, double(elapsed) / 1000.0 / fits);
+        }
+    }
+}
+
+// The text branch of GraphicsScene::load before GameParser. Kept here so
+// the numbers can be compared.
+static bool textStreamParse(QIODevice *device, QStringList *categories, QList<QPair<QString, QString> > *frames)
+{
+    QTextStream ts(device);
+    bool expectingTopic = true;
+    QRegExp commentRegexp("^ *#");
+    while (!ts.atEnd()) {
+        const QString line = ts.readLine().simplified();
+        if (line.indexOf(commentRegexp) == 0)
+            continue;
+        if (expectingTopic) {
+            if (line.isEmpty())
+                continue;
+            categories->append(line);
+            expectingTopic = false;
+        } else {
+            const QStringList split = line.split('|');
+            if (line.isEmpty() || split.size() != 2)
+                return false;
+            frames->append(qMakePair(split.at(0), split.at(1)));
+            if (frames->size() % 5 == 0)
+                expectingTopic = true;
+        }
+    }
+    return true;
+}
+
+// Deals the question lines of questions.txt into categories of five until
+// the file is at least megabytes big
+static bool writeParserInput(QFile *file, int megabytes)
+{
+    QFile source(":/questions.txt");
+    if (!source.open(QIODevice::ReadOnly))
+        return false;
+    QList<QByteArray> questions;
+    foreach(const QByteArray &line, source.readAll().split('\n')) {
+        if (line.count('|') == 1)
+            questions.append(line + '\n');
+    }
+    if (questions.isEmpty())
+        return false;
+    const qint64 size = qint64(megabytes) * 1024 * 1024;
+    qint64 written = 0;
+    int question = 0;
+    for (int category=0; written < size; ++category) {
+        written += file->write("# Generated by bench parser\nCategory " + QByteArray::number(category) + '\n');
+        for (int i=0; i<5; ++i)
+            written += file->write(questions.at(question++ % questions.size()));
+        written += file->write("\n");
+    }
+    return file->flush();
+}
+
+static void benchmarkParser(const QString &fileName, int iterations)
+{
+    QTemporaryFile temporary;
+    QString path = fileName;
+    if (path.isEmpty()) {
+        if (!temporary.open() || !writeParserInput(&temporary, 32)) {
+            fprintf(stderr, "Can't write parser input\n");
+            return;
+        }
+        path = temporary.fileName();
+    }
+
+    printf("%-12s %10s %10s %10s %12s %10s\n", "parser", "MB", "categories", "frames", "msecs/load", "MB/s");
+    for (int p=0; p<2; ++p) {
+        qint64 elapsed = 0;
+        qint64 size = 0;
+        int categoryCount = 0, frameCount = 0;
+        for (int i=0; i<iterations; ++i) {
+            QFile file(path);
+            if (!file.open(QIODevice::ReadOnly)) {
+                fprintf(stderr, "Can't open %s\n", qPrintable(path));
+                return;
+            }
+            size = file.size();
+            QStringList categories;
+            QList<QPair<QString, QString> > frames;
+            QElapsedTimer timer;
+            timer.start();
+            bool ok;
+            if (p == 0) {
+                ok = textStreamParse(&file, &categories, &frames);
+            } else {
+                GameParser parser;
+                ok = parser.parse(&file);
+                if (ok) {
+                    categories = parser.categories();
+                    frames = parser.frames();
+                }
+            }
+            elapsed += timer.nsecsElapsed();
+            if (!ok) {
+                fprintf(stderr, "Failed to parse %s\n", qPrintable(path));
+                return;
+            }
+            categoryCount = categories.size();
+            frameCount = frames.size();
+        }
+        const double msecs = double(elapsed) / 1000000.0 / iterations;
+        const double megabytes = double(size) / (1024.0 * 1024.0);
+        printf("%-12s %10.1f %10d %10d %12.2f %10.1f\n", p == 0 ? "QTextStream" : "GameParser",
+               megabytes, categoryCount, frameCount, msecs, megabytes / (msecs / 1000.0));
+    }
+}
+
+// Stands in for GraphicsScene, both engines are driven through next(int)
+class StateDriver : public QObject
+{
+    Q_OBJECT
+public:
+    StateDriver() { d.entered = false; }
+
+    bool waitFor(bool processEvents)
+    {
+        while (!d.entered && processEvents)
+            QCoreApplication::processEvents();
+        const bool entered = d.entered;
+        d.entered = false;
+        return entered;
+    }
+    void go(int type) { emit next(type); }
+public slots:
+    void onEntered() { d.entered = true; }
+signals:
+    void next(int type);
+private:
+    struct Data {
+        bool entered;
+    } d;
+};
+
+// A question that is answered wrong by one team and right by the next
+static const StateType statePath[] = {
+    ShowQuestion, PickTeam, PickRightOrWrong, WrongAnswer, ShowQuestion,
+    PickTeam, PickRightOrWrong, RightAnswer, Normal
+};
+enum { StatePathLength = sizeof(statePath) / sizeof(statePath[0]) };
+
+static void benchmarkStates(int iterations)
+{
+    printf("%-14s %12s %12s %10s %10s %14s\n", "engine", "transitions", "nsecs/trans", "p50", "p99", "allocs/trans");
+    const int count = iterations * StatePathLength;
+    QVector<qint64> latencies(count);
+    for (int e=0; e<2; ++e) {
+        StateDriver driver;
+        QObject target;
+        QStateMachine machine;
+        StateEngine engine;
+        const bool qt = (e == 0);
+        State *states[NumStates];
+        for (int i=0; i<NumStates; ++i) {
+            const StateType type = static_cast<StateType>(i);
+            const QVariant name = QString::fromLatin1(GameModel::stateName(type));
+            if (qt) {
+                states[i] = new State(type, &machine);
+                states[i]->assignProperty(&target, "objectName", name);
+                QObject::connect(states[i], SIGNAL(entered()), &driver, SLOT(onEntered()));
+            } else {
+                engine.assignProperty(type, &target, "objectName", name);
+            }
+        }
+        if (qt) {
+            for (int from=0; from<NumStates; ++from) {
+                for (int to=0; to<NumStates; ++to) {
+                    if (GameModel::isTransition(static_cast<StateType>(from), static_cast<StateType>(to)))
+                        states[from]->addTransition(static_cast<StateType>(to), new Transition(&driver, states[to]));
+                }
+            }
+            machine.setInitialState(states[Normal]);
+            machine.start();
+        } else {
+            QObject::connect(&driver, SIGNAL(next(int)), &engine, SLOT(next(int)));
+            QObject::connect(&engine, SIGNAL(entered(StateType)), &driver, SLOT(onEntered()));
+            engine.setState(Normal);
+        }
+        driver.waitFor(qt);
+
+        QElapsedTimer timer;
+        const int before = allocationCount();
+        for (int i=0; i<count; ++i) {
+            timer.start();
+            driver.go(statePath[i % StatePathLength]);
+            if (!driver.waitFor(qt)) {
+                fprintf(stderr, "%s didn't take transition %d\n", qt ? "QStateMachine" : "StateEngine", i);
+                return;
+            }
+            latencies[i] = timer.nsecsElapsed();
+        }
+        const int allocated = allocationCount() - before;
+        qint64 total = 0;
+        for (int i=0; i<count; ++i)
+            total += latencies.at(i);
+        qSort(latencies);
+        printf("%-14s %12d %12.1f %10lld %10lld %14.2f\n", qt ? "QStateMachine" : "StateEngine",
+               count, double(total) / count, latencies.at(count / 2), latencies.at((count * 99) / 100),
+               double(allocated) / count);
+        if (qt)
+            machine.stop();
+    }
+}
+
+int main(int argc, char **argv)
+{
+    QApplication a(argc, argv);
+    const QStringList args = a.arguments();
+    const QString mode = args.value(1);
+    if (mode == "layout") {
+        benchmarkLayout(qMax(1, args.value(2).toInt()));
+    } else if (mode == "parser") {
+        benchmarkParser(args.value(3), qMax(1, args.value(2).toInt()));
+    } else if (mode == "states") {
+        benchmarkStates(qMax(1, args.value(2).toInt()));
+    } else {
+        fprintf(stderr, "Usage: %s layout [iterations]\n"
+                "       %s parser [iterations] [file.jgm]\n"
+                "       %s states [iterations]\n", argv[0], argv[0], argv[0]);
+        return 1;
+    }
+    return 0;
+}
+
+#include "main.moc"
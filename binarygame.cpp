@@ -0,0 +1,150 @@
+#include "binarygame.h"
+#include <string.h>
+
+static const char magic[4] = { 'J', 'G', 'M', 'B' };
+
+int BinaryGameLoader::detect(const QString &fileName, const QByteArray &header) const
+{
+    if (header.size() >= int(sizeof(magic)) && !memcmp(header.constData(), magic, sizeof(magic)))
+        return 100;
+    return fileName.endsWith(QLatin1String(".jgmb"), Qt::CaseInsensitive) ? 10 : 0;
+}
+
+bool BinaryGameLoader::load(QIODevice *device, GameData *game, QString *error, LoadProgress *progress) const
+{
+    QSharedPointer<QFile> file;
+    QByteArray buffer;
+    const char *data = 0;
+    qint64 size = 0;
+    if (QFile *f = qobject_cast<QFile*>(device)) {
+        // The mapping has to outlive the caller's file so open our own
+        file = QSharedPointer<QFile>(new QFile(f->fileName()));
+        if (file->open(QIODevice::ReadOnly)) {
+            size = file->size();
+            data = reinterpret_cast<const char*>(file->map(0, size));
+        }
+        if (!data)
+            file.clear();
+    }
+    if (!data) {
+        buffer = device->readAll();
+        data = buffer.constData();
+        size = buffer.size();
+    }
+
+    const BinaryGameHeader *header = reinterpret_cast<const BinaryGameHeader*>(data);
+    if (size < qint64(sizeof(BinaryGameHeader)) || memcmp(header->magic, magic, sizeof(magic))) {
+        *error = QLatin1String("Not a compiled game");
+        return false;
+    } else if (header->byteOrder != BinaryGameHeader::ByteOrder) {
+        *error = QLatin1String("The game was compiled on a machine with a different byte order");
+        return false;
+    } else if (header->version != BinaryGameHeader::Version) {
+        *error = QString("Unsupported version %1 (expected %2)").
+                 arg(header->version).arg(int(BinaryGameHeader::Version));
+        return false;
+    } else if (header->frameCount != header->categoryCount * 5) {
+        *error = QString("%1 frames for %2 categories").arg(header->frameCount).arg(header->categoryCount);
+        return false;
+    }
+
+    const qint64 expected = sizeof(BinaryGameHeader)
+                            + (qint64(header->categoryCount) + (qint64(header->frameCount) * 2)) * sizeof(quint32)
+                            + qint64(header->stringCount) * sizeof(BinaryGameString)
+                            + qint64(header->dataSize) * sizeof(ushort);
+    if (size < expected) {
+        *error = QString("Truncated game. %1 bytes, expected %2").arg(size).arg(expected);
+        return false;
+    }
+
+    const quint32 *categories = reinterpret_cast<const quint32*>(header + 1);
+    const quint32 *frames = categories + header->categoryCount;
+    const BinaryGameString *strings = reinterpret_cast<const BinaryGameString*>(frames + (header->frameCount * 2));
+    const ushort *stringData = reinterpret_cast<const ushort*>(strings + header->stringCount);
+    for (quint32 i=0; i<header->stringCount; ++i) {
+        if (qint64(strings[i].offset) + strings[i].length > header->dataSize) {
+            *error = QString("String %1 is out of bounds").arg(i);
+            return false;
+        }
+    }
+
+    QVector<QString> table(header->stringCount);
+    for (quint32 i=0; i<header->stringCount; ++i) {
+        const QChar *chars = reinterpret_cast<const QChar*>(stringData + strings[i].offset);
+        table[i] = (file ? QString::fromRawData(chars, strings[i].length) : QString(chars, strings[i].length));
+    }
+
+    for (quint32 i=0; i<header->categoryCount + (header->frameCount * 2); ++i) {
+        if (categories[i] >= header->stringCount) {
+            *error = QString("Invalid string index %1").arg(categories[i]);
+            return false;
+        }
+    }
+    if (progress && progress->isCancelled()) {
+        *error = QLatin1String("Cancelled");
+        return false;
+    }
+    for (quint32 i=0; i<header->categoryCount; ++i)
+        game->categories.append(table.at(categories[i]));
+    for (quint32 i=0; i<header->frameCount; ++i)
+        game->frames.append(qMakePair(table.at(frames[i * 2]), table.at(frames[(i * 2) + 1])));
+    game->storage = file;
+    if (progress)
+        progress->setProgress(100);
+    return true;
+}
+
+bool BinaryGameLoader::write(QIODevice *device, const GameData &game, QString *error)
+{
+    if (game.categories.isEmpty() || game.frames.size() != game.categories.size() * 5) {
+        *error = QString("%1 frames for %2 categories").arg(game.frames.size()).arg(game.categories.size());
+        return false;
+    }
+
+    QHash<QString, quint32> indexes;
+    QVector<BinaryGameString> strings;
+    QVector<ushort> stringData;
+    QVector<quint32> references;
+    references.reserve(game.categories.size() + (game.frames.size() * 2));
+
+    QStringList all = game.categories;
+    for (int i=0; i<game.frames.size(); ++i)
+        all << game.frames.at(i).first << game.frames.at(i).second;
+    foreach(const QString &string, all) {
+        QHash<QString, quint32>::iterator it = indexes.find(string);
+        if (it == indexes.end()) {
+            BinaryGameString entry;
+            entry.offset = stringData.size();
+            entry.length = string.size();
+            for (int i=0; i<string.size(); ++i)
+                stringData.append(string.at(i).unicode());
+            it = indexes.insert(string, strings.size());
+            strings.append(entry);
+        }
+        references.append(it.value());
+    }
+    // Pads the file to a multiple of 4 bytes
+    if (stringData.size() % 2)
+        stringData.append(0);
+
+    BinaryGameHeader header;
+    memcpy(header.magic, magic, sizeof(magic));
+    header.byteOrder = BinaryGameHeader::ByteOrder;
+    header.version = BinaryGameHeader::Version;
+    header.categoryCount = game.categories.size();
+    header.frameCount = game.frames.size();
+    header.stringCount = strings.size();
+    header.dataSize = stringData.size();
+
+    const qint64 referencesSize = references.size() * sizeof(quint32);
+    const qint64 stringsSize = strings.size() * sizeof(BinaryGameString);
+    const qint64 dataSize = stringData.size() * sizeof(ushort);
+    if (device->write(reinterpret_cast<const char*>(&header), sizeof(header)) != qint64(sizeof(header))
+        || device->write(reinterpret_cast<const char*>(references.constData()), referencesSize) != referencesSize
+        || device->write(reinterpret_cast<const char*>(strings.constData()), stringsSize) != stringsSize
+        || device->write(reinterpret_cast<const char*>(stringData.constData()), dataSize) != dataSize) {
+        *error = device->errorString();
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,48 @@
+#ifndef BINARYGAME_H
+#define BINARYGAME_H
+
+#include "gameloader.h"
+
+// Compiled games (.jgmb). Everything is stored in the byte order of the
+// machine that compiled the game and is 4 byte aligned so the file can be
+// used straight from QFile::map:
+//
+// BinaryGameHeader
+// quint32 categories[categoryCount]      string index of each category
+// quint32 frames[frameCount * 2]         string index of question, answer
+// BinaryGameString strings[stringCount]
+// ushort data[dataSize]                  UTF-16, strings are deduplicated
+struct BinaryGameHeader
+{
+    enum {
+        Version = 1,
+        ByteOrder = 0x01020304
+    };
+
+    char magic[4];
+    quint32 byteOrder;
+    quint32 version;
+    quint32 categoryCount;
+    quint32 frameCount;
+    quint32 stringCount;
+    quint32 dataSize;
+};
+
+struct BinaryGameString
+{
+    quint32 offset, length; // in UTF-16 code units from the start of data
+};
+
+// Mapped files hand out QStrings made with QString::fromRawData so
+// GameData::storage has to be kept around for as long as they are used.
+class BinaryGameLoader : public GameLoader
+{
+public:
+    virtual int detect(const QString &fileName, const QByteArray &header) const;
+    virtual bool load(QIODevice *device, GameData *game, QString *error, LoadProgress *progress) const;
+    virtual QString name() const { return QLatin1String("binary"); }
+
+    static bool write(QIODevice *device, const GameData &game, QString *error);
+};
+
+#endif
@@ -0,0 +1,758 @@
+#include "gameloader.h"
+#include "gameparser.h"
+#include "binarygame.h"
+#include "random.h"
+#include "arguments.h"
+#include <QtScript>
+#ifdef Q_OS_UNIX
+#include <unistd.h>
+#endif
+
+struct LoaderRegistry
+{
+    LoaderRegistry()
+    {
+        loaders << new BinaryGameLoader << new TextGameLoader << new JavaScriptGameLoader;
+    }
+    ~LoaderRegistry()
+    {
+        qDeleteAll(loaders);
+    }
+
+    QMutex mutex;
+    QList<GameLoader*> loaders;
+};
+
+static LoaderRegistry *registry()
+{
+    static LoaderRegistry registry;
+    return &registry;
+}
+
+void GameLoader::registerLoader(GameLoader *loader)
+{
+    Q_ASSERT(loader);
+    LoaderRegistry *r = registry();
+    QMutexLocker lock(&r->mutex);
+    r->loaders.append(loader);
+}
+
+QList<GameLoader*> GameLoader::loaders()
+{
+    LoaderRegistry *r = registry();
+    QMutexLocker lock(&r->mutex);
+    return r->loaders;
+}
+
+GameLoader *GameLoader::loaderFor(QIODevice *device, const QString &fileName)
+{
+    QString name = fileName;
+    if (name.isEmpty()) {
+        if (QFile *file = qobject_cast<QFile*>(device))
+            name = file->fileName();
+    }
+    const QByteArray header = device->peek(HeaderSize);
+    GameLoader *best = 0;
+    int bestConfidence = 0;
+    foreach(GameLoader *loader, loaders()) {
+        const int confidence = loader->detect(name, header);
+        if (confidence > bestConfidence) {
+            best = loader;
+            bestConfidence = confidence;
+        }
+    }
+    return best;
+}
+
+bool GameLoader::load(QIODevice *device, GameData *game, QString *error, LoadProgress *progress)
+{
+    GameLoader *loader = loaderFor(device);
+    if (!loader) {
+        *error = QLatin1String("Unknown game format");
+        return false;
+    }
+    return loader->load(device, game, error, progress);
+}
+
+static inline QByteArray firstLine(const QByteArray &header, int *pos)
+{
+    while (*pos < header.size()) {
+        int end = header.indexOf('\n', *pos);
+        if (end == -1)
+            end = header.size();
+        const QByteArray line = header.mid(*pos, end - *pos).trimmed();
+        *pos = end + 1;
+        if (!line.isEmpty() && !line.startsWith('#'))
+            return line;
+    }
+    return QByteArray();
+}
+
+int TextGameLoader::detect(const QString &fileName, const QByteArray &header) const
+{
+    // This was the only format for a long time so it gets a say in
+    // everything nobody else recognizes
+    int confidence = 1;
+    if (fileName.endsWith(QLatin1String(".jgm"), Qt::CaseInsensitive)) {
+        confidence += 50;
+    } else if (fileName.endsWith(QLatin1String(".txt"), Qt::CaseInsensitive)) {
+        confidence += 20;
+    }
+    int pos = 0;
+    const QByteArray category = firstLine(header, &pos);
+    const QByteArray question = firstLine(header, &pos);
+    if (!category.isEmpty() && !category.contains('|') && question.count('|') == 1)
+        confidence += 40;
+    return confidence;
+}
+
+bool TextGameLoader::load(QIODevice *device, GameData *game, QString *error, LoadProgress *progress) const
+{
+    GameParser parser;
+    parser.setProgress(progress);
+    if (!parser.parse(device)) {
+        *error = QString("%1 line: %2").arg(parser.errorString()).arg(parser.errorLine());
+        return false;
+    }
+    game->categories = parser.categories();
+    game->frames = parser.frames();
+    if (progress)
+        progress->setProgress(100);
+    return true;
+}
+
+static inline QString field(const QString &string)
+{
+    return QString(string).replace(QLatin1Char('\n'), QLatin1Char(' ')).simplified();
+}
+
+bool TextGameLoader::write(QIODevice *device, const GameData &game, QString *error)
+{
+    if (game.categories.isEmpty() || game.frames.size() != game.categories.size() * 5) {
+        *error = QString("%1 frames for %2 categories").arg(game.frames.size()).arg(game.categories.size());
+        return false;
+    }
+    QTextStream ts(device);
+    ts.setCodec("UTF-8");
+    for (int i=0; i<game.categories.size(); ++i) {
+        if (i > 0)
+            ts << endl;
+        ts << field(game.categories.at(i)) << endl;
+        for (int j=0; j<5; ++j) {
+            const QPair<QString, QString> &frame = game.frames.at((i * 5) + j);
+            if (frame.first.contains(QLatin1Char('|')) || frame.second.contains(QLatin1Char('|'))) {
+                *error = QString("Question %1 of %2 contains a |").arg(j + 1).arg(game.categories.at(i));
+                return false;
+            }
+            ts << field(frame.first) << QLatin1Char('|') << field(frame.second) << endl;
+        }
+    }
+    ts.flush();
+    if (ts.status() != QTextStream::Ok) {
+        *error = device->errorString();
+        return false;
+    }
+    return true;
+}
+
+int JavaScriptGameLoader::detect(const QString &fileName, const QByteArray &header) const
+{
+    int confidence = 0;
+    if (fileName.endsWith(QLatin1String(".js"), Qt::CaseInsensitive))
+        confidence += 50;
+    const QByteArray start = header.trimmed();
+    if (start.startsWith("//") || start.startsWith("/*")) {
+        confidence += 40;
+    } else if (header.contains("function ") || header.contains("function(")) {
+        confidence += header.contains('{') ? 40 : 20;
+    }
+    return confidence;
+}
+
+// rand(n) returns [1, n], rand(from, to) returns [from + 1, to]. Every
+// engine registers this with its own Random as the argument.
+static QScriptValue random(QScriptContext *ctx, QScriptEngine *, void *arg)
+{
+    Random *random = static_cast<Random*>(arg);
+    switch (ctx->argumentCount()) {
+    case 1: {
+        if (!ctx->argument(0).isNumber()) {
+            ctx->throwError("Invalid argument");
+            return QScriptValue();
+        }
+        const int max = ctx->argument(0).toInt32();
+        if (max <= 0) {
+            ctx->throwError("Invalid argument");
+            return QScriptValue();
+        }
+        return int(random->bounded(max)) + 1; }
+    default:
+        ctx->throwError("Invalid amount of arguments to rand(). Need 1 or 2");
+        return QScriptValue();
+    case 2:
+        break;
+    }
+    if (!ctx->argument(0).isNumber() || !ctx->argument(1).isNumber()) {
+        ctx->throwError("Invalid arguments");
+        return QScriptValue();
+    }
+
+    const int from = ctx->argument(0).toInt32();
+    const int to = ctx->argument(1).toInt32();
+    if (from >= to) {
+        ctx->throwError("Invalid arguments");
+        return QScriptValue();
+    }
+
+    // The range doesn't fit in an int for rand(-2e9, 2e9)
+    return int(qint64(from) + 1 + random->bounded(quint32(to) - quint32(from)));
+}
+
+static qint64 residentMemory()
+{
+#ifdef Q_OS_LINUX
+    QFile file("/proc/self/statm");
+    if (file.open(QIODevice::ReadOnly)) {
+        const QList<QByteArray> fields = file.readAll().split(' ');
+        if (fields.size() > 1)
+            return fields.at(1).toLongLong() * sysconf(_SC_PAGESIZE);
+    }
+#endif
+    return 0;
+}
+
+// QScriptEngine processes events in the thread it runs in every
+// ProcessEventsInterval ms while it evaluates, even in the middle of a
+// loop. The watchdog lives in that thread and aborts the evaluation when
+// the load is cancelled, when the script has run for longer than
+// --script-timeout=ms (10s) or when the process has grown by more than
+// --script-memory=MB (256MB) since the script started.
+//
+// QScriptEngine doesn't report its own heap, so the memory budget is
+// measured on the resident size of the whole process and is only checked
+// on Linux. Scripts running concurrently in other threads grow the same
+// number, so each running watchdog adds one budget to what the process
+// is allowed to grow by. Anything else the process allocates meanwhile
+// still counts against the script.
+class ScriptWatchdog : public QObject
+{
+    Q_OBJECT
+public:
+    enum { ProcessEventsInterval = 50 };
+
+    ScriptWatchdog(QScriptEngine *engine, LoadProgress *progress)
+        : QObject()
+    {
+        d.engine = engine;
+        d.progress = progress;
+        const QStringList args = QCoreApplication::arguments();
+        d.timeout = argumentValue(args, "script-timeout", "10000").toInt();
+        d.memoryLimit = qint64(argumentValue(args, "script-memory", "256").toInt()) * 1024 * 1024;
+        d.memoryStart = residentMemory();
+        active.ref();
+        d.elapsed.start();
+        engine->setProcessEventsInterval(ProcessEventsInterval);
+        d.timer.setInterval(ProcessEventsInterval);
+        connect(&d.timer, SIGNAL(timeout()), this, SLOT(check()));
+        d.timer.start();
+    }
+
+    ~ScriptWatchdog()
+    {
+        active.deref();
+    }
+
+    // Aborted evaluations don't leave an exception behind
+    QString error() const { return d.error; }
+private slots:
+    void check()
+    {
+        if (!d.error.isEmpty())
+            return;
+        if (d.progress && d.progress->isCancelled()) {
+            d.error = QLatin1String("Cancelled");
+        } else if (d.timeout > 0 && d.elapsed.elapsed() > d.timeout) {
+            d.error = QString("The script ran for more than %1ms").arg(d.timeout);
+        } else if (d.memoryStart && d.memoryLimit > 0
+                   && residentMemory() - d.memoryStart > d.memoryLimit * active.fetchAndAddAcquire(0)) {
+            d.error = QString("The script used more than %1MB").arg(d.memoryLimit / (1024 * 1024));
+        } else {
+            return;
+        }
+        d.engine->abortEvaluation(QScriptValue(d.error));
+    }
+private:
+    struct Data {
+        QScriptEngine *engine;
+        LoadProgress *progress;
+        QElapsedTimer elapsed;
+        int timeout;
+        qint64 memoryStart, memoryLimit;
+        QTimer timer;
+        QString error;
+    } d;
+
+    static QAtomicInt active;
+};
+
+QAtomicInt ScriptWatchdog::active;
+
+struct ScriptJob
+{
+    QString program;
+    GameData *game;
+    QString *error;
+    LoadProgress *progress;
+    quint64 seed;
+    bool ok;
+    // Released when the job is done, for callers in other threads
+    QSemaphore *finished;
+};
+Q_DECLARE_METATYPE(ScriptJob*)
+
+struct GenerateJob
+{
+    int id, category, row;
+    quint64 seed;
+    QString question, answer, error;
+    bool ok;
+    QSemaphore *finished;
+    // For prefetched jobs, set by the runner and the generator respectively
+    QAtomicInt done, cancelled;
+};
+Q_DECLARE_METATYPE(GenerateJob*)
+Q_DECLARE_METATYPE(QSharedPointer<GenerateJob>)
+
+// All script games are run by one engine in one thread. The engine keeps
+// the compiled program of each script it has seen, keyed by a hash of the
+// source. Every job runs the program in a context of its own and then
+// calls init(), so re-rolling a board doesn't compile it again but starts
+// from fresh globals.
+//
+// rand() is seeded with the job's seed before the top level code and
+// init() and with a seed derived from it and the frame before each
+// generate(), so a board comes out the same for a seed whatever order
+// its frames are revealed in and whichever boards the engine ran before.
+//
+// Categories with a generate() function are kept here under an id until
+// the ScriptQuestionGenerator handed out for them goes away.
+//
+// The watchdog has the engine process events while it evaluates, which
+// can deliver the next job in the middle of the current one. Jobs are
+// queued and run one after the other instead, callers in other threads
+// wait for their job to be released rather than for the slot to return.
+class ScriptRunner : public QObject
+{
+    Q_OBJECT
+public:
+    enum { MaxPrograms = 16 };
+
+    ScriptRunner()
+    {
+        d.engine = 0;
+        d.busy = false;
+        d.programs.setMaxCost(MaxPrograms);
+        d.lastGeneratorId = 0;
+    }
+
+    static ScriptRunner *instance();
+    static ScriptRunner *local();
+    void call(const char *slot, QGenericArgument argument, QSemaphore *finished);
+public slots:
+    void run(ScriptJob *job);
+    void generate(GenerateJob *job);
+    void prefetch(QSharedPointer<GenerateJob> job);
+    void releaseGenerators(int id) { d.generators.remove(id); }
+private:
+    // One of them is set
+    struct Job {
+        Job() : script(0), generate(0) {}
+        ScriptJob *script;
+        GenerateJob *generate;
+        QSharedPointer<GenerateJob> prefetch;
+    };
+    void enqueue(const Job &job);
+    void execute(const Job &job);
+    void runJob(ScriptJob *job);
+    void generateJob(GenerateJob *job);
+    bool evaluate(ScriptJob *job, const ScriptWatchdog *watchdog);
+    bool generateFrame(GenerateJob *job, const ScriptWatchdog *watchdog);
+    void resetContext();
+    static void stop();
+
+    struct Data {
+        QScriptEngine *engine;
+        QCache<QByteArray, QScriptProgram> programs;
+        QByteArray contextHash;
+        Random random;
+        QHash<int, QScriptValueList> generators;
+        int lastGeneratorId;
+        bool busy;
+        QList<Job> jobs;
+    } d;
+};
+
+class ScriptQuestionGenerator : public QuestionGenerator
+{
+public:
+    ScriptQuestionGenerator(ScriptRunner *runner, int id, quint64 seed) : runner(runner), id(id), seed(seed) {}
+    ~ScriptQuestionGenerator();
+    virtual bool generate(int category, int row, QString *question, QString *answer, QString *error);
+    virtual void prefetch(int category, int row);
+    virtual bool isReady(int category, int row) const;
+private:
+    void initJob(GenerateJob *job, int category, int row) const;
+    static int key(int category, int row) { return (category << 8) | row; }
+
+    const QPointer<ScriptRunner> runner;
+    const int id;
+    const quint64 seed;
+    // Queued on the runner, the events keep them alive until they've run
+    QHash<int, QSharedPointer<GenerateJob> > prefetched;
+};
+
+static QThread *scriptThread = 0;
+static ScriptRunner *scriptRunner = 0;
+
+ScriptRunner *ScriptRunner::instance()
+{
+    static QMutex mutex;
+    QMutexLocker lock(&mutex);
+    if (!scriptRunner) {
+        qRegisterMetaType<ScriptJob*>("ScriptJob*");
+        qRegisterMetaType<GenerateJob*>("GenerateJob*");
+        qRegisterMetaType<QSharedPointer<GenerateJob> >("QSharedPointer<GenerateJob>");
+        scriptThread = new QThread;
+        scriptRunner = new ScriptRunner;
+        scriptRunner->moveToThread(scriptThread);
+        scriptThread->start();
+        qAddPostRoutine(stop);
+    }
+    return scriptRunner;
+}
+
+// Batch generation runs a runner per worker thread instead of queueing
+// everything on the shared one
+ScriptRunner *ScriptRunner::local()
+{
+    static QThreadStorage<ScriptRunner*> runners;
+    if (!runners.hasLocalData()) {
+        qRegisterMetaType<ScriptJob*>("ScriptJob*");
+        qRegisterMetaType<GenerateJob*>("GenerateJob*");
+        qRegisterMetaType<QSharedPointer<GenerateJob> >("QSharedPointer<GenerateJob>");
+        runners.setLocalData(new ScriptRunner);
+    }
+    return runners.localData();
+}
+
+void ScriptRunner::call(const char *slot, QGenericArgument argument, QSemaphore *finished)
+{
+    if (QThread::currentThread() == thread()) {
+        // A job of this runner's own can't wait for one that is running
+        Q_ASSERT(!d.busy);
+        QMetaObject::invokeMethod(this, slot, Qt::DirectConnection, argument);
+    } else {
+        QMetaObject::invokeMethod(this, slot, Qt::QueuedConnection, argument);
+        finished->acquire();
+    }
+}
+
+void ScriptRunner::stop()
+{
+    scriptThread->quit();
+    scriptThread->wait();
+    delete scriptRunner;
+    delete scriptThread;
+    scriptRunner = 0;
+    scriptThread = 0;
+}
+
+void ScriptRunner::resetContext()
+{
+    if (!d.contextHash.isEmpty()) {
+        d.engine->popContext();
+        d.contextHash.clear();
+    }
+    d.engine->clearExceptions();
+}
+
+void ScriptRunner::run(ScriptJob *job)
+{
+    Job queued;
+    queued.script = job;
+    enqueue(queued);
+}
+
+void ScriptRunner::generate(GenerateJob *job)
+{
+    Job queued;
+    queued.generate = job;
+    enqueue(queued);
+}
+
+void ScriptRunner::prefetch(QSharedPointer<GenerateJob> job)
+{
+    Job queued;
+    queued.prefetch = job;
+    enqueue(queued);
+}
+
+void ScriptRunner::enqueue(const Job &job)
+{
+    d.jobs.append(job);
+    // Called from inside a running job, it takes this one when it's done
+    if (d.busy)
+        return;
+    d.busy = true;
+    while (!d.jobs.isEmpty())
+        execute(d.jobs.takeFirst());
+    d.busy = false;
+}
+
+void ScriptRunner::execute(const Job &job)
+{
+    if (job.script) {
+        runJob(job.script);
+        if (job.script->finished)
+            job.script->finished->release();
+    } else if (job.generate) {
+        generateJob(job.generate);
+        if (job.generate->finished)
+            job.generate->finished->release();
+    } else {
+        if (!job.prefetch->cancelled)
+            generateJob(job.prefetch.data());
+        job.prefetch->done.fetchAndStoreRelease(1);
+    }
+}
+
+void ScriptRunner::runJob(ScriptJob *job)
+{
+    if (!d.engine) {
+        // Created here so it belongs to this thread
+        d.engine = new QScriptEngine(this);
+        d.engine->globalObject().setProperty("rand", d.engine->newFunction(random, &d.random));
+    }
+    const ScriptWatchdog watchdog(d.engine, job->progress);
+    job->ok = evaluate(job, &watchdog);
+    if (!job->ok)
+        resetContext();
+}
+
+void ScriptRunner::generateJob(GenerateJob *job)
+{
+    const ScriptWatchdog watchdog(d.engine, 0);
+    job->ok = generateFrame(job, &watchdog);
+    d.engine->clearExceptions();
+}
+
+#define TEST(op)                                                        \
+    if (!watchdog->error().isEmpty()) {                                 \
+        *error = watchdog->error();                                     \
+        return false;                                                   \
+    } else if (engine.hasUncaughtException()) {                         \
+        *error = QString("Exception %1 at line %2").                    \
+                 arg(engine.uncaughtException().toString()).            \
+                 arg(engine.uncaughtExceptionLineNumber());             \
+        return false;                                                   \
+    } else if (!(op)) {                                                 \
+        *error = QString("%1 failed").arg(#op);                         \
+        return false;                                                   \
+    }
+
+bool ScriptRunner::evaluate(ScriptJob *job, const ScriptWatchdog *watchdog)
+{
+    QScriptEngine &engine = *d.engine;
+    QString *error = job->error;
+    GameData *game = job->game;
+
+    const QByteArray hash = QCryptographicHash::hash(job->program.toUtf8(), QCryptographicHash::Sha1);
+    QScriptProgram *program = d.programs.object(hash);
+    if (!program) {
+        program = new QScriptProgram(job->program);
+        d.programs.insert(hash, program);
+    }
+    // A fresh context every time, a board mustn't depend on the globals or
+    // the rand() calls of the boards before it
+    resetContext();
+    engine.pushContext();
+    d.contextHash = hash;
+    d.random.setSeed(job->seed);
+    engine.evaluate(*program);
+    TEST(true);
+
+    game->seed = job->seed;
+    game->generated = true;
+    const QScriptValue categories = engine.evaluate("init()");
+    TEST(categories.isArray());
+    const int categoryCount = categories.property("length").toInt32();
+    TEST(categoryCount > 0);
+    QScriptValueList generators;
+    for (int i=0; i<categoryCount; ++i) {
+        const QScriptValue category = categories.property(i);
+
+        TEST(category.isObject());
+        const QScriptValue topic = category.property("topic");
+        TEST(!topic.isNull());
+        game->categories.append(topic.toString());
+        if (category.property("generate").isFunction()) {
+            while (generators.size() < i)
+                generators.append(QScriptValue());
+            generators.append(category);
+            for (int j=0; j<5; ++j)
+                game->frames.append(qMakePair(QString(), QString()));
+            continue;
+        }
+        const QScriptValue questions = category.property("questions");
+        TEST(questions.isArray() && questions.property("length").toInt32() == 5);
+        const QScriptValue answers = category.property("answers");
+        TEST(answers.isArray() && answers.property("length").toInt32() == 5);
+        for (int j=0; j<5; ++j) {
+            game->frames.append(qMakePair(questions.property(j).toString(), answers.property(j).toString()));
+        }
+    }
+    if (!generators.isEmpty()) {
+        const int id = ++d.lastGeneratorId;
+        d.generators.insert(id, generators);
+        game->generator = QSharedPointer<QuestionGenerator>(new ScriptQuestionGenerator(this, id, job->seed));
+    }
+    return true;
+}
+
+bool ScriptRunner::generateFrame(GenerateJob *job, const ScriptWatchdog *watchdog)
+{
+    QScriptEngine &engine = *d.engine;
+    QString *error = &job->error;
+    QScriptValue category = d.generators.value(job->id).value(job->category);
+    TEST(category.isObject());
+    d.random.setSeed(job->seed);
+    const QScriptValue frame = category.property("generate").call(category, QScriptValueList() << job->row);
+    TEST(frame.isObject());
+    job->question = frame.property("question").toString();
+    job->answer = frame.property("answer").toString();
+    return true;
+}
+
+ScriptQuestionGenerator::~ScriptQuestionGenerator()
+{
+    foreach(const QSharedPointer<GenerateJob> &job, prefetched)
+        job->cancelled.fetchAndStoreRelaxed(1);
+    if (!runner) {
+        return;
+    } else if (QThread::currentThread() == runner->thread()) {
+        runner->releaseGenerators(id);
+    } else {
+        QMetaObject::invokeMethod(runner, "releaseGenerators", Qt::QueuedConnection, Q_ARG(int, id));
+    }
+}
+
+void ScriptQuestionGenerator::initJob(GenerateJob *job, int category, int row) const
+{
+    job->id = id;
+    job->category = category;
+    job->row = row;
+    job->seed = Random::mix(seed ^ ((quint64(category) << 32) | quint64(row)));
+    job->ok = false;
+    job->finished = 0;
+}
+
+bool ScriptQuestionGenerator::generate(int category, int row, QString *question, QString *answer, QString *error)
+{
+    const QSharedPointer<GenerateJob> ahead = prefetched.take(key(category, row));
+    if (ahead && ahead->done.fetchAndAddAcquire(0)) {
+        if (!ahead->ok) {
+            *error = ahead->error;
+            return false;
+        }
+        *question = ahead->question;
+        *answer = ahead->answer;
+        return true;
+    } else if (ahead) {
+        // Comes out the same from the seed, the queued one can be skipped
+        ahead->cancelled.fetchAndStoreRelaxed(1);
+    }
+
+    GenerateJob job;
+    initJob(&job, category, row);
+    if (!runner) {
+        *error = QLatin1String("The script engine is gone");
+        return false;
+    }
+    QSemaphore finished;
+    job.finished = &finished;
+    runner->call("generate", Q_ARG(GenerateJob*, &job), &finished);
+    if (!job.ok) {
+        *error = job.error;
+        return false;
+    }
+    *question = job.question;
+    *answer = job.answer;
+    return true;
+}
+
+void ScriptQuestionGenerator::prefetch(int category, int row)
+{
+    if (!runner || prefetched.contains(key(category, row)))
+        return;
+    QSharedPointer<GenerateJob> job(new GenerateJob);
+    initJob(job.data(), category, row);
+    prefetched[key(category, row)] = job;
+    const Qt::ConnectionType type = (QThread::currentThread() == runner->thread()
+                                     ? Qt::DirectConnection : Qt::QueuedConnection);
+    QMetaObject::invokeMethod(runner, "prefetch", type, Q_ARG(QSharedPointer<GenerateJob>, job));
+}
+
+bool ScriptQuestionGenerator::isReady(int category, int row) const
+{
+    if (!runner)
+        return true;
+    const QSharedPointer<GenerateJob> job = prefetched.value(key(category, row));
+    return job && job->done.fetchAndAddAcquire(0);
+}
+
+static bool runScript(ScriptRunner *runner, const QString &program, quint64 seed,
+                      GameData *game, QString *error, LoadProgress *progress)
+{
+    ScriptJob job;
+    job.seed = seed;
+    job.program = program;
+    job.game = game;
+    job.error = error;
+    job.progress = progress;
+    job.ok = false;
+    QSemaphore finished;
+    job.finished = &finished;
+    runner->call("run", Q_ARG(ScriptJob*, &job), &finished);
+    return job.ok;
+}
+
+bool JavaScriptGameLoader::load(QIODevice *device, GameData *game, QString *error, LoadProgress *progress) const
+{
+    return runScript(ScriptRunner::instance(), QTextStream(device).readAll(), Random::nextSeed(),
+                     game, error, progress);
+}
+
+bool JavaScriptGameLoader::evaluate(const QString &program, quint64 seed, GameData *game, QString *error)
+{
+    return runScript(ScriptRunner::local(), program, seed, game, error, 0);
+}
+
+bool generateFrames(GameData *game, QString *error)
+{
+    if (!game->generator)
+        return true;
+    for (int i=0; i<game->frames.size(); ++i) {
+        QPair<QString, QString> &frame = game->frames[i];
+        if (!frame.first.isNull())
+            continue;
+        QString err;
+        if (!game->generator->generate(i / 5, i % 5, &frame.first, &frame.second, &err)) {
+            *error = QString("Can't generate question %1 of %2: %3").
+                     arg((i % 5) + 1).arg(game->categories.value(i / 5), err);
+            return false;
+        }
+    }
+    return true;
+}
+
+#include "gameloader.moc"
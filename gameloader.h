@@ -0,0 +1,111 @@
+#ifndef GAMELOADER_H
+#define GAMELOADER_H
+
+#include <QtCore>
+
+// Produces the question and answer of a frame when it is revealed. Frames
+// that are generated this way are null strings in GameData::frames.
+class QuestionGenerator
+{
+public:
+    virtual ~QuestionGenerator() {}
+    virtual bool generate(int category, int row, QString *question, QString *answer, QString *error) = 0;
+
+    // Starts on a frame without waiting for it. Once isReady() says so,
+    // generate() for it returns without waiting either.
+    virtual void prefetch(int category, int row) { Q_UNUSED(category); Q_UNUSED(row); }
+    virtual bool isReady(int category, int row) const { Q_UNUSED(category); Q_UNUSED(row); return true; }
+};
+
+struct GameData
+{
+    GameData() : seed(0), generated(false) {}
+
+    QStringList categories;
+    QList<QPair<QString, QString> > frames;
+    // Set by loaders that hand out strings pointing into a mapped file
+    QSharedPointer<QFile> storage;
+    QSharedPointer<QuestionGenerator> generator;
+    // What rand() was seeded with, for boards made by a script
+    quint64 seed;
+    bool generated;
+};
+
+// Generates every frame that was left for the generator
+bool generateFrames(GameData *game, QString *error);
+
+// Shared between a loader running in a worker thread and whoever waits for
+// it. Progress is a percentage, -1 until the loader knows.
+class LoadProgress
+{
+public:
+    LoadProgress() { d.progress = -1; }
+
+    int progress() const { return d.progress; }
+    void setProgress(int percent) { d.progress = percent; }
+    bool isCancelled() const { return d.cancelled; }
+    void cancel() { d.cancelled = 1; }
+private:
+    struct Data {
+        QAtomicInt progress, cancelled;
+    } d;
+};
+
+// Each game format has a loader. GameLoader::loaderFor asks every registered
+// loader how well it recognizes a file from its name and the first bytes of
+// its contents and picks the most confident one, so a file is only ever
+// parsed once, by the parser that understands it.
+//
+// Other formats can be added with GameLoader::registerLoader. The registry
+// takes ownership of the loader. Loaders are shared between threads so
+// load() must not touch any state but its arguments. It should check
+// progress, when given, every now and then and give up if it's cancelled.
+class GameLoader
+{
+public:
+    virtual ~GameLoader() {}
+
+    enum { HeaderSize = 512 };
+
+    // Confidence in [0, 100]. 0 means this loader can't read the file.
+    virtual int detect(const QString &fileName, const QByteArray &header) const = 0;
+    virtual bool load(QIODevice *device, GameData *game, QString *error, LoadProgress *progress) const = 0;
+    virtual QString name() const = 0;
+
+    static void registerLoader(GameLoader *loader);
+    static QList<GameLoader*> loaders();
+    static GameLoader *loaderFor(QIODevice *device, const QString &fileName = QString());
+    static bool load(QIODevice *device, GameData *game, QString *error, LoadProgress *progress = 0);
+};
+
+class TextGameLoader : public GameLoader
+{
+public:
+    virtual int detect(const QString &fileName, const QByteArray &header) const;
+    virtual bool load(QIODevice *device, GameData *game, QString *error, LoadProgress *progress) const;
+    virtual QString name() const { return QLatin1String("text"); }
+
+    static bool write(QIODevice *device, const GameData &game, QString *error);
+};
+
+// Scripts define init(), which returns an array of categories:
+//
+// { topic: "...", questions: [ 5 strings ], answers: [ 5 strings ] }
+//
+// A category can instead have a generate(row) function that returns
+// { question: "...", answer: "..." }. It is called when one of the
+// category's frames is revealed, so only questions that are played cost
+// anything. The board starts on a frame in the background when it is
+// hovered.
+class JavaScriptGameLoader : public GameLoader
+{
+public:
+    virtual int detect(const QString &fileName, const QByteArray &header) const;
+    virtual bool load(QIODevice *device, GameData *game, QString *error, LoadProgress *progress) const;
+    virtual QString name() const { return QLatin1String("javascript"); }
+
+    // Evaluates program with an engine that belongs to the calling thread
+    static bool evaluate(const QString &program, quint64 seed, GameData *game, QString *error);
+};
+
+#endif
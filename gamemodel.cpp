@@ -0,0 +1,234 @@
+#include "gamemodel.h"
+
+GameModel::GameModel(QObject *parent)
+    : QObject(parent)
+{
+    qRegisterMetaType<StateType>("StateType");
+    qRegisterMetaType<GameModel::FrameStatus>("GameModel::FrameStatus");
+    d.penalty = 50;
+    clear();
+}
+
+void GameModel::setGame(const QStringList &categories, const QList<QPair<QString, QString> > &frames,
+                        const QStringList &teams)
+{
+    clear();
+    Q_ASSERT(categories.size() * QuestionsPerCategory == frames.size());
+    d.categories = categories;
+    d.frames.resize(frames.size());
+    for (int i=0; i<frames.size(); ++i) {
+        Frame &frame = d.frames[i];
+        frame.question = frames.at(i).first;
+        frame.answer = frames.at(i).second;
+        frame.value = ((i % QuestionsPerCategory) + 1) * 100;
+        frame.status = Hidden;
+    }
+    d.teams.resize(teams.size());
+    for (int i=0; i<teams.size(); ++i) {
+        Team &team = d.teams[i];
+        team.name = teams.at(i);
+        team.points = 0;
+        team.attempted = false;
+    }
+    d.framesLeft = d.frames.size();
+    emit gameStarted();
+}
+
+void GameModel::clear()
+{
+    d.state = Normal;
+    d.categories.clear();
+    d.frames.clear();
+    d.teams.clear();
+    d.attempted = 0;
+    d.framesLeft = 0;
+    d.currentFrame = d.activeTeam = -1;
+    d.right = d.wrong = d.timedout = 0;
+}
+
+#define TO(state) (1 << (state))
+// The edges of the state graph, a bit per target state
+static const quint16 transitions[NumStates] = {
+    TO(ShowQuestion),                               // Normal
+    TO(TimeOut) | TO(PickTeam),                     // ShowQuestion
+    TO(Normal) | TO(Finished),                      // TimeOut
+    TO(NoAnswers) | TO(PickRightOrWrong),           // PickTeam
+    TO(ShowQuestion),                               // TeamTimedOut
+    TO(RightAnswer) | TO(WrongAnswer),              // PickRightOrWrong
+    TO(ShowQuestion) | TO(Normal) | TO(Finished),   // WrongAnswer
+    TO(Normal) | TO(Finished),                      // RightAnswer
+    TO(Normal) | TO(Finished),                      // NoAnswers
+    0                                               // Finished
+};
+#undef TO
+
+bool GameModel::isTransition(StateType from, StateType to)
+{
+    Q_ASSERT(from >= 0 && from < NumStates && to >= 0 && to < NumStates);
+    return transitions[from] & (1 << to);
+}
+
+const char *GameModel::stateName(StateType state)
+{
+    static const char *names[] = {
+        "Normal", "ShowQuestion", "TimeOut", "PickTeam",
+        "TeamTimedOut", "PickRightOrWrong", "WrongAnswer",
+        "RightAnswer", "NoAnswers", "Finished", 0
+    };
+    return state >= 0 && state < NumStates ? names[state] : 0;
+}
+
+void GameModel::setQuestion(int frame, const QString &question, const QString &answer)
+{
+    d.frames[frame].question = question;
+    d.frames[frame].answer = answer;
+}
+
+bool GameModel::pickFrame(int frame)
+{
+    if (d.state != Normal || frame < 0 || frame >= d.frames.size() || d.frames.at(frame).status != Hidden)
+        return false;
+    d.currentFrame = frame;
+    enter(ShowQuestion);
+    return true;
+}
+
+bool GameModel::stopClock()
+{
+    if (d.state != ShowQuestion)
+        return false;
+    enter(PickTeam);
+    return true;
+}
+
+bool GameModel::timeOut()
+{
+    if (d.state != ShowQuestion)
+        return false;
+    enter(TimeOut);
+    return true;
+}
+
+bool GameModel::pickTeam(int team)
+{
+    if (d.state != PickTeam || team < 0 || team >= d.teams.size() || d.teams.at(team).attempted)
+        return false;
+    d.activeTeam = team;
+    enter(PickRightOrWrong);
+    return true;
+}
+
+bool GameModel::noAnswers()
+{
+    if (d.state != PickTeam)
+        return false;
+    enter(NoAnswers);
+    return true;
+}
+
+bool GameModel::answer(bool right)
+{
+    if (d.state != PickRightOrWrong)
+        return false;
+    enter(right ? RightAnswer : WrongAnswer);
+    return true;
+}
+
+bool GameModel::finishQuestion()
+{
+    if (d.state != RightAnswer)
+        return false;
+    enter(questionFinished());
+    return true;
+}
+
+void GameModel::enter(StateType state)
+{
+    while (state != NumStates) {
+        Q_ASSERT(isTransition(d.state, state));
+        d.state = state;
+        const StateType next = apply(state);
+        emit stateChanged(state);
+        state = next;
+    }
+}
+
+// Does what entering state means for the game and returns the state it
+// leads to on its own, NumStates if it waits for input
+StateType GameModel::apply(StateType state)
+{
+    switch (state) {
+    case Normal:
+    case Finished:
+        if (d.currentFrame != -1) {
+            d.currentFrame = d.activeTeam = -1;
+            for (int i=0; i<d.teams.size(); ++i)
+                d.teams[i].attempted = false;
+            d.attempted = 0;
+            --d.framesLeft;
+        }
+        break;
+    case ShowQuestion:
+        Q_ASSERT(d.currentFrame != -1);
+        d.activeTeam = -1;
+        if (d.attempted == d.teams.size())
+            return TimeOut;
+        break;
+    case TimeOut:
+        setFrameStatus(Failed);
+        return questionFinished();
+    case PickTeam:
+        Q_ASSERT(d.activeTeam == -1);
+        break;
+    case TeamTimedOut:
+    case WrongAnswer:
+        if (state == TeamTimedOut) {
+            ++d.timedout;
+        } else {
+            ++d.wrong;
+        }
+        Q_ASSERT(d.activeTeam != -1);
+        addPoints(-(d.frames.at(d.currentFrame).value * d.penalty) / 100);
+        setFrameStatus(Failed);
+        if (d.attempted + 1 == d.teams.size())
+            return questionFinished();
+        d.teams[d.activeTeam].attempted = true;
+        ++d.attempted;
+        return ShowQuestion;
+    case NoAnswers:
+        ++d.wrong;
+        Q_ASSERT(d.activeTeam == -1);
+        setFrameStatus(Failed);
+        return questionFinished();
+    case RightAnswer:
+        ++d.right;
+        Q_ASSERT(d.activeTeam != -1);
+        addPoints(d.frames.at(d.currentFrame).value);
+        setFrameStatus(Succeeded);
+        break;
+    case PickRightOrWrong:
+    case NumStates:
+        break;
+    }
+    return NumStates;
+}
+
+StateType GameModel::questionFinished() const
+{
+    return d.framesLeft > 1 ? Normal : Finished;
+}
+
+void GameModel::setFrameStatus(FrameStatus status)
+{
+    Q_ASSERT(d.currentFrame != -1);
+    d.frames[d.currentFrame].status = status;
+    emit frameStatusChanged(d.currentFrame, status);
+}
+
+void GameModel::addPoints(int points)
+{
+    Q_ASSERT(d.activeTeam != -1);
+    Team &team = d.teams[d.activeTeam];
+    team.points += points;
+    emit pointsChanged(d.activeTeam, team.points);
+}
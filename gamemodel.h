@@ -0,0 +1,122 @@
+#ifndef GAMEMODEL_H
+#define GAMEMODEL_H
+
+#include <QtCore>
+
+enum StateType {
+    Normal = 0,
+    ShowQuestion,
+    TimeOut,
+    PickTeam,
+    TeamTimedOut,
+    PickRightOrWrong,
+    WrongAnswer,
+    RightAnswer,
+    NoAnswers,
+    Finished,
+    NumStates
+};
+
+// The rules of the game without anything to look at. It owns the board,
+// the teams and their points and decides which state comes next. Views
+// call the input functions when something is clicked and follow along
+// with stateChanged(). Inputs that don't make sense in the current state
+// return false and change nothing.
+//
+// Everything happens synchronously. States that decide where to go on
+// their own (a wrong answer going back to ShowQuestion, a finished
+// question going to Normal or Finished) emit stateChanged() for
+// themselves and then for the state they lead to before the input returns.
+class GameModel : public QObject
+{
+    Q_OBJECT
+public:
+    enum FrameStatus {
+        Hidden,
+        Failed,
+        Succeeded
+    };
+
+    GameModel(QObject *parent = 0);
+
+    void setGame(const QStringList &categories, const QList<QPair<QString, QString> > &frames,
+                 const QStringList &teams);
+    void clear();
+
+    StateType state() const { return d.state; }
+    static bool isTransition(StateType from, StateType to);
+    static const char *stateName(StateType state);
+
+    int categoryCount() const { return d.categories.size(); }
+    QString category(int category) const { return d.categories.at(category); }
+
+    // Frames are stored category by category, QuestionsPerCategory each
+    enum { QuestionsPerCategory = 5 };
+    int frameCount() const { return d.frames.size(); }
+    QString question(int frame) const { return d.frames.at(frame).question; }
+    QString answer(int frame) const { return d.frames.at(frame).answer; }
+    void setQuestion(int frame, const QString &question, const QString &answer);
+    int value(int frame) const { return d.frames.at(frame).value; }
+    FrameStatus frameStatus(int frame) const { return d.frames.at(frame).status; }
+    int framesLeft() const { return d.framesLeft; }
+
+    int teamCount() const { return d.teams.size(); }
+    QString teamName(int team) const { return d.teams.at(team).name; }
+    int points(int team) const { return d.teams.at(team).points; }
+    bool hasAttempted(int team) const { return d.teams.at(team).attempted; }
+
+    // -1 when there is none
+    int currentFrame() const { return d.currentFrame; }
+    int activeTeam() const { return d.activeTeam; }
+
+    // What a wrong answer costs, in percent of the frame's value
+    int wrongAnswerPenalty() const { return d.penalty; }
+    void setWrongAnswerPenalty(int percent) { d.penalty = percent; }
+
+    int rightCount() const { return d.right; }
+    int wrongCount() const { return d.wrong; }
+    int timedOutCount() const { return d.timedout; }
+
+    bool pickFrame(int frame);          // Normal -> ShowQuestion
+    bool stopClock();                   // ShowQuestion -> PickTeam
+    bool timeOut();                     // ShowQuestion -> TimeOut
+    bool pickTeam(int team);            // PickTeam -> PickRightOrWrong
+    bool noAnswers();                   // PickTeam -> NoAnswers
+    bool answer(bool right);            // PickRightOrWrong -> RightAnswer or WrongAnswer
+    bool finishQuestion();              // RightAnswer -> Normal or Finished
+signals:
+    void gameStarted();
+    void stateChanged(StateType state);
+    void frameStatusChanged(int frame, GameModel::FrameStatus status);
+    void pointsChanged(int team, int points);
+private:
+    void enter(StateType state);
+    StateType apply(StateType state);
+    StateType questionFinished() const;
+    void setFrameStatus(FrameStatus status);
+    void addPoints(int points);
+
+    struct Frame {
+        QString question, answer;
+        int value;
+        FrameStatus status;
+    };
+    struct Team {
+        QString name;
+        int points;
+        bool attempted;
+    };
+    struct Data {
+        StateType state;
+        QStringList categories;
+        QVector<Frame> frames;
+        QVector<Team> teams;
+        int attempted;
+        int framesLeft;
+        int currentFrame, activeTeam;
+        int right, wrong, timedout;
+        int penalty;
+    } d;
+};
+
+#endif
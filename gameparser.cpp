@@ -0,0 +1,190 @@
+#include "gameparser.h"
+#include "gameloader.h"
+#include <string.h>
+#include <stdarg.h>
+
+static inline bool isSpace(char ch)
+{
+    switch (ch) {
+    case ' ':
+    case '\t':
+    case '\r':
+    case '\v':
+    case '\f':
+        return true;
+    default:
+        break;
+    }
+    return false;
+}
+
+GameParser::GameParser()
+{
+    d.file = 0;
+    d.mapped = 0;
+    d.data = 0;
+    d.size = 0;
+    d.errorLine = -1;
+    d.progress = 0;
+}
+
+GameParser::~GameParser()
+{
+    clear();
+}
+
+void GameParser::clear()
+{
+    if (d.mapped)
+        d.file->unmap(d.mapped);
+    d.file = 0;
+    d.mapped = 0;
+    d.buffer.clear();
+    d.data = 0;
+    d.size = 0;
+    d.categories.clear();
+    d.fields.clear();
+    d.errorString.clear();
+    d.errorLine = -1;
+}
+
+bool GameParser::parse(QIODevice *device)
+{
+    clear();
+    QFile *file = qobject_cast<QFile*>(device);
+    if (file && !file->isSequential() && file->size() > 0 && file->size() <= INT_MAX) {
+        d.mapped = file->map(0, file->size());
+        if (d.mapped) {
+            d.file = file;
+            return scan(reinterpret_cast<const char*>(d.mapped), file->size());
+        }
+    }
+    // Not a file or it can't be mapped, this is the only copy we make
+    d.buffer = device->readAll();
+    return scan(d.buffer.constData(), d.buffer.size());
+}
+
+bool GameParser::parse(const char *data, int size)
+{
+    clear();
+    return scan(data, size);
+}
+
+bool GameParser::scan(const char *data, int size)
+{
+    d.data = data;
+    d.size = size;
+    const char *pos = data;
+    const char *end = data + size;
+    if (size >= 3 && !memcmp(data, "\xEF\xBB\xBF", 3))
+        pos += 3;
+
+    // A category with five short questions is rarely less than 100 bytes
+    d.categories.reserve((size / 100) + 1);
+    d.fields.reserve(((size / 100) + 1) * QuestionsPerCategory * 2);
+
+    bool expectingCategory = true;
+    int line = 0;
+    while (pos < end) {
+        ++line;
+        if (d.progress && !(line % 4096)) {
+            if (d.progress->isCancelled())
+                return fail(line, "Cancelled");
+            d.progress->setProgress(int(qint64(pos - data) * 100 / size));
+        }
+        const char *eol = static_cast<const char*>(memchr(pos, '\n', end - pos));
+        if (!eol)
+            eol = end;
+        const char *first = pos;
+        const char *last = eol;
+        pos = (eol < end ? eol + 1 : end);
+        while (first < last && isSpace(*first))
+            ++first;
+        while (last > first && isSpace(*(last - 1)))
+            --last;
+        if (first < last && *first == '#')
+            continue;
+
+        if (expectingCategory) {
+            if (first == last)
+                continue;
+            d.categories.append(range(first, last));
+            expectingCategory = false;
+        } else if (first == last) {
+            return fail(line, "Didn't expect an empty line here. I was looking for question number %d for %s",
+                        (frameCount() % QuestionsPerCategory) + 1, qPrintable(category(categoryCount() - 1)));
+        } else {
+            const char *bar = static_cast<const char*>(memchr(first, '|', last - first));
+            if (!bar || memchr(bar + 1, '|', last - bar - 1)) {
+                return fail(line, "I don't understand this line. There can only be one | per question line (%s)",
+                            qPrintable(QString::fromUtf8(first, last - first)));
+            }
+            d.fields.append(range(first, bar));
+            d.fields.append(range(bar + 1, last));
+            if (frameCount() % QuestionsPerCategory == 0)
+                expectingCategory = true;
+        }
+    }
+    if (!expectingCategory) {
+        return fail(line, "%s only has %d questions", qPrintable(category(categoryCount() - 1)),
+                    frameCount() % QuestionsPerCategory);
+    }
+    return true;
+}
+
+GameParser::Range GameParser::range(const char *start, const char *end) const
+{
+    while (start < end && isSpace(*start))
+        ++start;
+    while (end > start && isSpace(*(end - 1)))
+        --end;
+    Range r;
+    r.start = start - d.data;
+    r.length = end - start;
+    // Only strings that QString::simplified() would change pay for it
+    r.simplify = false;
+    for (const char *ch = start; ch < end; ++ch) {
+        if (*ch == ' ' ? (ch + 1 < end && *(ch + 1) == ' ') : isSpace(*ch)) {
+            r.simplify = true;
+            break;
+        }
+    }
+    return r;
+}
+
+QString GameParser::string(const Range &range) const
+{
+    const QString string = QString::fromUtf8(d.data + range.start, range.length);
+    return range.simplify ? string.simplified() : string;
+}
+
+bool GameParser::fail(int line, const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    d.errorString.vsprintf(format, args);
+    va_end(args);
+    d.errorLine = line;
+    d.categories.clear();
+    d.fields.clear();
+    return false;
+}
+
+QStringList GameParser::categories() const
+{
+    QStringList ret;
+    ret.reserve(d.categories.size());
+    foreach(const Range &range, d.categories)
+        ret.append(string(range));
+    return ret;
+}
+
+QList<QPair<QString, QString> > GameParser::frames() const
+{
+    QList<QPair<QString, QString> > ret;
+    const int count = frameCount();
+    ret.reserve(count);
+    for (int i=0; i<count; ++i)
+        ret.append(qMakePair(question(i), answer(i)));
+    return ret;
+}
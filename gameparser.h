@@ -0,0 +1,66 @@
+#ifndef GAMEPARSER_H
+#define GAMEPARSER_H
+
+#include <QtCore>
+
+class LoadProgress;
+// Parser for the plain text .jgm format:
+//
+// # comment
+// Category
+// Question|Answer   (five of these per category)
+//
+// The parser never copies the input. Files are mapped with QFile::map and
+// lines and fields are recorded as byte ranges into the mapping. Strings
+// are only created when a category, question or answer is asked for, so
+// the device (or the data passed in) has to outlive those calls.
+class GameParser
+{
+public:
+    GameParser();
+    ~GameParser();
+
+    enum { QuestionsPerCategory = 5 };
+
+    void setProgress(LoadProgress *progress) { d.progress = progress; }
+
+    bool parse(QIODevice *device);
+    bool parse(const char *data, int size);
+    void clear();
+
+    QString errorString() const { return d.errorString; }
+    int errorLine() const { return d.errorLine; }
+
+    int categoryCount() const { return d.categories.size(); }
+    QString category(int index) const { return string(d.categories.at(index)); }
+    int frameCount() const { return d.fields.size() / 2; }
+    QString question(int index) const { return string(d.fields.at(index * 2)); }
+    QString answer(int index) const { return string(d.fields.at((index * 2) + 1)); }
+
+    QStringList categories() const;
+    QList<QPair<QString, QString> > frames() const;
+private:
+    struct Range {
+        int start, length;
+        bool simplify;
+    };
+    bool scan(const char *data, int size);
+    Range range(const char *start, const char *end) const;
+    QString string(const Range &range) const;
+    bool fail(int line, const char *format, ...);
+
+    struct Data {
+        QFile *file;
+        uchar *mapped;
+        QByteArray buffer;
+        const char *data;
+        int size;
+
+        QVector<Range> categories, fields;
+        QString errorString;
+        int errorLine;
+        LoadProgress *progress;
+    } d;
+};
+
+#endif
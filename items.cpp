@@ -1,41 +1,202 @@
 #include "scene.h"
 #include "items.h"
+#include "stats.h"
 
-static inline void initTextLayout(QTextLayout *layout, const QRectF &rect, int pixelSize)
+struct FontMetricsEntry {
+    QFont font;
+    int height;
+};
+
+// Faces are also rendered on the pre-warm threads, hence the lock
+static inline FontMetricsEntry fontMetrics(const QFont &font, int pixelSize)
+{
+    static QMutex mutex;
+    static QHash<QString, QHash<int, FontMetricsEntry> > cache;
+    QMutexLocker lock(&mutex);
+    QHash<int, FontMetricsEntry> &sizes = cache[font.key()];
+    QHash<int, FontMetricsEntry>::iterator it = sizes.find(pixelSize);
+    if (it == sizes.end()) {
+        FontMetricsEntry entry;
+        entry.font = font;
+        entry.font.setPixelSize(pixelSize);
+        entry.height = QFontMetrics(entry.font).height();
+        it = sizes.insert(pixelSize, entry);
+    }
+    return it.value();
+}
+
+static inline bool layoutText(QTextLayout *layout, const QRectF &rect, const FontMetricsEntry &metrics)
+{
+    layout->clearLayout();
+    layout->setFont(metrics.font);
+    layout->beginLayout();
+    QPointF pos(rect.topLeft());
+    forever {
+        QTextLine line = layout->createLine();
+        if (!line.isValid())
+            break;
+        line.setLineWidth(rect.width());
+        line.setPosition(pos);
+        pos += QPointF(0, metrics.height);
+    }
+    layout->endLayout();
+    const QRectF textRect = layout->boundingRect();
+    return rect.size().expandedTo(textRect.size()) == rect.size();
+}
+
+int initTextLayout(QTextLayout *layout, const QRectF &rect, const QFont &font, int *layouts)
 {
+    enum { MinimumPixelSize = 9 };
     layout->setCacheEnabled(true);
     QTextOption option;
     option.setAlignment(Qt::AlignCenter);
     layout->setTextOption(option);
-    forever {
-        layout->clearLayout();
-        QFont f;
-        f.setPixelSize(pixelSize--);
-        layout->setFont(f);
-        layout->beginLayout();
-        const int h = QFontMetrics(f).height();
-        QPointF pos(rect.topLeft());
-        forever {
-            QTextLine line = layout->createLine();
-            if (!line.isValid())
-                break;
-            line.setLineWidth(rect.width());
-            line.setPosition(pos);
-            pos += QPointF(0, h);
-        }
-        layout->endLayout();
-        const QRectF textRect = layout->boundingRect();
-        if (pixelSize <= 8 || rect.size().expandedTo(textRect.size()) == rect.size()) {
-            break;
+
+    // Text height grows with the pixel size so we can bisect for the
+    // largest size that fits instead of walking down one pixel at a time.
+    const int maximum = qMax<int>(1, rect.height() / 5);
+    int low = qMin<int>(MinimumPixelSize, maximum);
+    int high = maximum;
+    int best = low;
+    int laidOut = -1;
+    int count = 0;
+    while (low <= high) {
+        const int pixelSize = (low + high) / 2;
+        ++count;
+        laidOut = pixelSize;
+        if (::layoutText(layout, rect, ::fontMetrics(font, pixelSize))) {
+            best = pixelSize;
+            low = pixelSize + 1;
+        } else {
+            high = pixelSize - 1;
         }
     }
+    if (laidOut != best) {
+        ++count;
+        ::layoutText(layout, rect, ::fontMetrics(font, best));
+    }
+    if (layouts)
+        *layouts = count;
+    return best;
 }
 
+// Text of compiled games points into the game's file mapping. Whatever a
+// cache keeps may outlive the game, so it gets its own copy.
+static inline QString ownedText(const QString &text)
+{
+    return QString(text.constData(), text.size());
+}
+
+uint qHash(const TextLayoutCache::Key &key)
+{
+    return qHash(key.text) ^ qHash(key.font) ^ uint((key.size.width() << 16) ^ key.size.height());
+}
+
+TextLayoutCache *TextLayoutCache::instance()
+{
+    static TextLayoutCache cache;
+    return &cache;
+}
+
+TextLayoutCache::~TextLayoutCache()
+{
+    for (QHash<Key, Entry>::const_iterator it = d.entries.begin(); it != d.entries.end(); ++it)
+        delete it.value().layout;
+}
+
+QTextLayout *TextLayoutCache::acquire(const Key &key, const QFont &font)
+{
+    Q_ASSERT(!key.isNull());
+    QHash<Key, Entry>::iterator it = d.entries.find(key);
+    if (it != d.entries.end()) {
+        ++d.hits;
+        ++it.value().refs;
+        return it.value().layout;
+    }
+    ++d.misses;
+    Key owned(key);
+    owned.text = ::ownedText(key.text);
+    Entry entry;
+    entry.layout = new QTextLayout(owned.text);
+    entry.pixelSize = ::initTextLayout(entry.layout, QRectF(QPointF(), key.size), font);
+    entry.refs = 1;
+    d.entries.insert(owned, entry);
+    return entry.layout;
+}
+
+QTextLayout *TextLayoutCache::layout(const Key &key)
+{
+    const QHash<Key, Entry>::const_iterator it = d.entries.find(key);
+    if (it == d.entries.end())
+        return 0;
+    ++d.hits;
+    return it.value().layout;
+}
+
+void TextLayoutCache::release(const Key &key)
+{
+    if (key.isNull())
+        return;
+    QHash<Key, Entry>::iterator it = d.entries.find(key);
+    Q_ASSERT(it != d.entries.end());
+    if (it != d.entries.end() && !--it.value().refs) {
+        delete it.value().layout;
+        d.entries.erase(it);
+    }
+}
+
+int TextLayoutCache::pixelSize(const Key &key) const
+{
+    return d.entries.value(key).pixelSize;
+}
+
+uint qHash(const FaceAtlas::Key &key)
+{
+    return qHash(key.text) ^ qHash(key.font) ^ key.background ^ (key.color << 1)
+        ^ uint((key.size.width() << 16) ^ key.size.height()) ^ uint(key.hovered);
+}
+
+FaceAtlas::FaceAtlas(int maximumMemory)
+{
+    d.faces.setMaxCost(maximumMemory);
+    d.hits = d.misses = 0;
+}
+
+QPixmap FaceAtlas::find(const Key &key)
+{
+    if (const QPixmap *pixmap = d.faces.object(key)) {
+        ++d.hits;
+        return *pixmap;
+    }
+    ++d.misses;
+    return QPixmap();
+}
+
+void FaceAtlas::insert(const Key &key, const QPixmap &pixmap)
+{
+    Key owned(key);
+    owned.text = ::ownedText(key.text);
+    d.faces.insert(owned, new QPixmap(pixmap), pixmap.width() * pixmap.height() * (pixmap.depth() / 8));
+}
+
+// Items share their rasterized faces through the scene's FaceAtlas, which
+// is why they don't keep a QGraphicsItem cache of their own.
 Item::Item()
 {
-    setCacheMode(ItemCoordinateCache);
     d.yRotation = 0;
     d.hovered = false;
+    d.revealStart = 0;
+    d.revealLength = -1;
+    d.paintCount = 0;
+    d.paintTime = 0;
+}
+
+Item::~Item()
+{
+    invalidateTextLayout();
+    // Another item may get the same address
+    if (RenderStats::isEnabled())
+        RenderStats::instance()->removeItem(this);
 }
 
 void Item::mousePressEvent(QGraphicsSceneMouseEvent *event)
@@ -53,6 +214,7 @@ QColor Item::backgroundColor() const
 void Item::setBackgroundColor(const QColor &color)
 {
     d.backgroundColor = color;
+    invalidateFaces();
     update();
 }
 
@@ -64,11 +226,16 @@ QColor Item::color() const
 void Item::setColor(const QColor &color)
 {
     d.color = color;
+    invalidateFaces();
     update();
 }
 
 void Item::setText(const QString &text)
 {
+    if (text == d.text)
+        return;
+    invalidateTextLayout();
+    invalidateFaces();
     d.text = text;
     update();
 }
@@ -78,6 +245,15 @@ QString Item::text() const
     return d.text;
 }
 
+void Item::setRevealRange(int start, int length)
+{
+    if (start != d.revealStart || length != d.revealLength) {
+        d.revealStart = start;
+        d.revealLength = length;
+        update();
+    }
+}
+
 GraphicsScene *Item::graphicsScene() const
 {
     return qobject_cast<GraphicsScene*>(scene());
@@ -86,10 +262,34 @@ GraphicsScene *Item::graphicsScene() const
 void Item::setYRotation(qreal yRotation)
 {
     d.yRotation = yRotation;
+    updateTransform();
+}
+
+QRectF Item::visualGeometry() const
+{
+    return d.visualGeometry.isValid() ? d.visualGeometry : geometry();
+}
+
+// Shows the item in rect without resizing it. The item keeps its
+// geometry, and with it its text layout and cached pixmap, and is
+// scaled and moved into place by its transform instead.
+void Item::setVisualGeometry(const QRectF &rect)
+{
+    d.visualGeometry = rect;
+    updateTransform();
+}
+
+void Item::updateTransform()
+{
     QTransform transform;
     const QRectF r = rect();
+    if (d.visualGeometry.isValid() && !r.isEmpty()) {
+        const QRectF g = geometry();
+        transform.translate(d.visualGeometry.x() - g.x(), d.visualGeometry.y() - g.y());
+        transform.scale(d.visualGeometry.width() / r.width(), d.visualGeometry.height() / r.height());
+    }
     transform.translate(r.width() / 2, r.height() / 2);
-    transform.rotate(yRotation, Qt::YAxis);
+    transform.rotate(d.yRotation, Qt::YAxis);
     transform.translate(-r.width() / 2, -r.height() / 2);
     setTransform(transform);
 }
@@ -101,14 +301,83 @@ qreal Item::yRotation() const
 
 void Item::hoverEnterEvent(QGraphicsSceneHoverEvent *)
 {
-    d.hovered = true;
-    update();
+    if (!d.hovered) {
+        d.hovered = true;
+        update();
+        emit hovered(this);
+    }
 }
 
 void Item::hoverLeaveEvent(QGraphicsSceneHoverEvent *)
 {
-    d.hovered = false;
-    update();
+    if (d.hovered) {
+        d.hovered = false;
+        update();
+    }
+}
+
+void Item::resizeEvent(QGraphicsSceneResizeEvent *event)
+{
+    invalidateTextLayout();
+    invalidateFaces();
+    QGraphicsWidget::resizeEvent(event);
+    if (d.visualGeometry.isValid())
+        updateTransform();
+}
+
+void Item::moveEvent(QGraphicsSceneMoveEvent *event)
+{
+    QGraphicsWidget::moveEvent(event);
+    if (d.visualGeometry.isValid())
+        updateTransform();
+}
+
+void Item::changeEvent(QEvent *event)
+{
+    if (event->type() == QEvent::FontChange) {
+        invalidateTextLayout();
+        invalidateFaces();
+    }
+    QGraphicsWidget::changeEvent(event);
+}
+
+QTextLayout *Item::textLayout(const QSize &size)
+{
+    if (!size.isValid())
+        return 0;
+    TextLayoutCache *cache = TextLayoutCache::instance();
+    if (d.layoutKey.size != size) {
+        cache->release(d.layoutKey);
+        d.layoutKey = TextLayoutCache::Key(d.text, font(), size);
+        return cache->acquire(d.layoutKey, font());
+    }
+    return cache->layout(d.layoutKey);
+}
+
+void Item::invalidateTextLayout()
+{
+    TextLayoutCache::instance()->release(d.layoutKey);
+    d.layoutKey = TextLayoutCache::Key();
+}
+
+const QPixmap &Item::face(const QSize &size, bool hovered)
+{
+    QPixmap &pixmap = d.faces[hovered ? 1 : 0];
+    if (pixmap.size() != size) {
+        const FaceAtlas::Key key(d.text, font(), d.backgroundColor, d.color, size, hovered);
+        FaceAtlas *atlas = graphicsScene()->faceAtlas();
+        pixmap = atlas->find(key);
+        if (pixmap.isNull()) {
+            pixmap = renderFace(d.text, size, hovered);
+            atlas->insert(key, pixmap);
+        }
+    }
+    return pixmap;
+}
+
+void Item::invalidateFaces()
+{
+    d.faces[0] = d.faces[1] = QPixmap();
 }
 
 void Item::setAcceptHoverEvents(bool enabled) // override
@@ -122,6 +391,27 @@ void Item::setAcceptHoverEvents(bool enabled) // override
 
 
 void Item::paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *)
+{
+    const bool timed = RenderStats::isEnabled();
+    QElapsedTimer timer;
+    if (timed)
+        timer.start();
+    paintItem(painter, option);
+    recordPaint(timed ? timer.nsecsElapsed() : -1);
+}
+
+// Paints are always counted. They're only timed with --stats, in which
+// case nsecs is the time the paint took, otherwise it's -1
+void Item::recordPaint(qint64 nsecs)
+{
+    ++d.paintCount;
+    if (nsecs < 0)
+        return;
+    d.paintTime += nsecs;
+    RenderStats::instance()->addPaint(this, nsecs);
+}
+
+void Item::paintItem(QPainter *painter, const QStyleOptionGraphicsItem *option)
 {
 //    const QTransform &worldTransform = painter->worldTransform();
 //     bool mirrored = false;
@@ -129,17 +419,115 @@ void Item::paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWid
 //         mirrored = true;
 //         brush = Qt::black;
 //     }
-    QBrush brush = d.hovered ? d.color : d.backgroundColor;
-    enum { Margin = 5 };
-    qDrawShadePanel(painter, option->rect, palette(), false, Margin, &brush);
-    Q_ASSERT(d.color.isValid());
-    painter->setPen(d.color);
-    const QRectF r = option->rect.adjusted(Margin, Margin, -Margin, -Margin);
-    QTextLayout layout(d.text);
-    ::initTextLayout(&layout, r, r.height() / 5);
-    painter->setPen(d.hovered ? d.backgroundColor : d.color);
-    const QRectF textRect = layout.boundingRect();
-    layout.draw(painter, r.center() - textRect.center());
+    const QSize size = option->rect.size();
+    GraphicsScene *scene = graphicsScene();
+    if (d.revealLength < 0 && scene && d.faces[d.hovered ? 1 : 0].size() != size && scene->isAnimating()) {
+        // Geometry and text animations go through a new size or text
+        // every frame. Those faces are drawn straight away rather than
+        // rasterized and pushing the board's faces out of the atlas.
+        const QRect r = option->rect.adjusted(Margin, Margin, -Margin, -Margin);
+        paintFace(painter, option->rect, textLayout(r.size()), d.hovered, false);
+    } else if (d.revealLength < 0 && scene) {
+        painter->drawPixmap(option->rect.topLeft(), face(size, d.hovered));
+        // Keep the other hover state rasterized as well so entering and
+        // leaving the item only ever swaps pixmaps
+        if (acceptHoverEvents())
+            face(size, !d.hovered);
+    } else {
+        const QRect r = option->rect.adjusted(Margin, Margin, -Margin, -Margin);
+        paintFace(painter, option->rect, textLayout(r.size()), d.hovered, true);
+    }
+}
+
+void Item::paintFace(QPainter *painter, const QRect &rect, const QTextLayout *layout, bool hovered, bool reveal) const
+{
+    if (!reveal || d.revealLength < 0) {
+        drawFace(painter, rect, palette(), d.backgroundColor, d.color, layout, hovered);
+        return;
+    }
+    drawFace(painter, rect, palette(), d.backgroundColor, d.color, 0, hovered);
+    if (layout) {
+        const QRect r = rect.adjusted(Margin, Margin, -Margin, -Margin);
+        drawRevealed(painter, layout, QRectF(r).center() - layout->boundingRect().center());
+    }
+}
+
+void Item::drawFace(QPainter *painter, const QRect &rect, const QPalette &palette,
+                    const QColor &background, const QColor &color,
+                    const QTextLayout *layout, bool hovered)
+{
+    QBrush brush = hovered ? color : background;
+    qDrawShadePanel(painter, rect, palette, false, Margin, &brush);
+    Q_ASSERT(color.isValid());
+    painter->setPen(hovered ? background : color);
+    if (layout) {
+        const QRect r = rect.adjusted(Margin, Margin, -Margin, -Margin);
+        const QRectF textRect = layout->boundingRect();
+        layout->draw(painter, QRectF(r).center() - textRect.center());
+    }
+}
+
+QPixmap Item::renderFace(const QString &text, const QSize &size, bool hovered) const
+{
+    QPixmap pixmap(size);
+    pixmap.fill(Qt::transparent);
+    QPainter painter(&pixmap);
+    const TextLayoutCache::Key key(text, font(), size - QSize(Margin * 2, Margin * 2));
+    TextLayoutCache *cache = TextLayoutCache::instance();
+    const QTextLayout *layout = key.isNull() ? 0 : cache->acquire(key, font());
+    paintFace(&painter, pixmap.rect(), layout, hovered, false);
+    cache->release(key);
+    return pixmap;
+}
+
+FaceRequest Item::faceRequest(const QSize &size, bool hovered) const
+{
+    FaceRequest request;
+    request.key = FaceAtlas::Key(d.text, font(), d.backgroundColor, d.color, size, hovered);
+    request.font = font();
+    request.palette = palette();
+    return request;
+}
+
+// Runs on the pre-warm threads so it can't touch the item or the shared
+// text layout cache.
+QImage Item::renderFaceImage(const FaceRequest &request)
+{
+    const FaceAtlas::Key &key = request.key;
+    QImage image(key.size, QImage::Format_ARGB32_Premultiplied);
+    image.fill(0);
+    QPainter painter(&image);
+    const QSize textSize = key.size - QSize(Margin * 2, Margin * 2);
+    QTextLayout layout(key.text);
+    if (textSize.isValid())
+        ::initTextLayout(&layout, QRectF(QPointF(), textSize), request.font);
+    drawFace(&painter, image.rect(), request.palette, QColor::fromRgba(key.background),
+             QColor::fromRgba(key.color), textSize.isValid() ? &layout : 0, key.hovered);
+    return image;
+}
+
+void Item::drawRevealed(QPainter *painter, const QTextLayout *layout, const QPointF &offset) const
+{
+    const int start = d.revealStart;
+    const int end = d.revealStart + d.revealLength;
+    for (int i=0; i<layout->lineCount(); ++i) {
+        const QTextLine line = layout->lineAt(i);
+        const int lineStart = line.textStart();
+        const int lineEnd = lineStart + line.textLength();
+        if (lineEnd <= start || lineStart >= end)
+            continue;
+        if (lineStart >= start && lineEnd <= end) {
+            line.draw(painter, offset);
+            continue;
+        }
+        const qreal x1 = line.cursorToX(qMax(start, lineStart));
+        const qreal x2 = line.cursorToX(qMin(end, lineEnd));
+        painter->save();
+        painter->setClipRect(QRectF(offset.x() + qMin(x1, x2), offset.y() + line.y(),
+                                    qAbs(x2 - x1), line.height()), Qt::IntersectClip);
+        line.draw(painter, offset);
+        painter->restore();
+    }
 }
 
 SelectorItem::SelectorItem()
@@ -173,6 +561,45 @@ Frame::Frame(int row, int column)
     d.row = row;
     d.column = column;
     d.value = 0;
+    d.cardMode = false;
+    d.face = Front;
+}
+
+void Frame::prepareCard(const QString &back, const QSize &faceSize)
+{
+    d.cardBack = back;
+    d.cardSize = faceSize;
+}
+
+void Frame::setYRotation(qreal yRotation)
+{
+    Item::setYRotation(yRotation);
+    if (!d.cardMode)
+        return;
+
+    const qreal angle = ::fmod(qAbs(yRotation), qreal(360.0));
+    if (qFuzzyIsNull(angle)) {
+        d.faces[Front] = d.faces[Back] = QPixmap();
+        d.cardSize = QSize();
+        d.face = Front;
+        return;
+    }
+
+    // Both faces are rasterized once when the flip starts. From then on
+    // the flip is just the pixmaps under a changing transform.
+    if (d.faces[Front].isNull()) {
+        const QSize size = d.cardSize.isValid() ? d.cardSize : Item::size().toSize();
+        d.faces[Front] = renderFace(text(), size);
+        d.faces[Back] = d.cardBack.isEmpty() ? d.faces[Front] : renderFace(d.cardBack, size);
+    }
+    if (d.face == Front && angle >= 90.0) {
+        d.face = Back;
+        if (!d.cardBack.isEmpty()) {
+            setText(d.cardBack);
+            d.cardBack.clear();
+        }
+        update();
+    }
 }
 
 void TeamProxy::setGeometry(const QRectF &geometry)
@@ -203,10 +630,30 @@ QVariant Item::itemChange(GraphicsItemChange change, const QVariant &value)
     return QGraphicsWidget::itemChange(change, value);
 }
 
-#ifdef QT_DEBUG
 void Frame::paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget)
 {
-    Item::paint(painter, option, widget);
+    const bool timed = RenderStats::isEnabled();
+    QElapsedTimer timer;
+    if (timed)
+        timer.start();
+    Q_UNUSED(widget);
+    const QPixmap &face = d.faces[d.face];
+    if (face.isNull()) {
+        paintItem(painter, option);
+    } else {
+        painter->save();
+        painter->setRenderHint(QPainter::SmoothPixmapTransform);
+        const QRectF target(option->rect);
+        if (qCos(yRotation() * M_PI / 180.0) < 0) {
+            // Seen from behind. Mirror it so the face reads the right way around
+            painter->translate(target.center());
+            painter->scale(-1, 1);
+            painter->translate(-target.center());
+        }
+        painter->drawPixmap(target, face, face.rect());
+        painter->restore();
+    }
+#ifdef QT_DEBUG
     static const bool showAll = QCoreApplication::arguments().contains("--show-all");
     if (showAll) {
         painter->save();
@@ -218,5 +665,6 @@ void Frame::paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWi
         painter->drawText(rect, Qt::AlignLeft|Qt::AlignBottom, d.answer);
         painter->restore();
     }
-}
 #endif
+    recordPaint(timed ? timer.nsecsElapsed() : -1);
+}
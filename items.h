@@ -4,6 +4,98 @@
 #include <QtGui>
 
 class GraphicsScene;
+
+int initTextLayout(QTextLayout *layout, const QRectF &rect, const QFont &font, int *layouts = 0);
+
+class TextLayoutCache
+{
+public:
+    struct Key {
+        Key() {}
+        Key(const QString &t, const QFont &f, const QSize &s) : text(t), font(f.key()), size(s) {}
+        bool isNull() const { return !size.isValid(); }
+        bool operator==(const Key &other) const
+        { return size == other.size && text == other.text && font == other.font; }
+
+        QString text, font;
+        QSize size;
+    };
+
+    static TextLayoutCache *instance();
+    ~TextLayoutCache();
+
+    QTextLayout *acquire(const Key &key, const QFont &font);
+    QTextLayout *layout(const Key &key);
+    void release(const Key &key);
+    int pixelSize(const Key &key) const;
+
+    int count() const { return d.entries.size(); }
+    int hits() const { return d.hits; }
+    int misses() const { return d.misses; }
+    void resetCounters() { d.hits = d.misses = 0; }
+private:
+    TextLayoutCache() { d.hits = d.misses = 0; }
+    struct Entry {
+        QTextLayout *layout;
+        int pixelSize;
+        int refs;
+    };
+    struct Data {
+        QHash<Key, Entry> entries;
+        int hits, misses;
+    } d;
+};
+
+uint qHash(const TextLayoutCache::Key &key);
+
+class FaceAtlas
+{
+public:
+    struct Key {
+        Key() : background(0), color(0), hovered(false) {}
+        Key(const QString &t, const QFont &f, const QColor &b, const QColor &c, const QSize &s, bool h)
+            : text(t), font(f.key()), background(b.rgba()), color(c.rgba()), size(s), hovered(h)
+        {}
+        bool operator==(const Key &other) const
+        {
+            return size == other.size && hovered == other.hovered && background == other.background
+                && color == other.color && text == other.text && font == other.font;
+        }
+
+        QString text, font;
+        QRgb background, color;
+        QSize size;
+        bool hovered;
+    };
+
+    enum { DefaultMaximumMemory = 64 * 1024 * 1024 };
+    FaceAtlas(int maximumMemory = DefaultMaximumMemory);
+
+    QPixmap find(const Key &key);
+    bool contains(const Key &key) const { return d.faces.contains(key); }
+    void insert(const Key &key, const QPixmap &pixmap);
+    void clear() { d.faces.clear(); }
+
+    int count() const { return d.faces.size(); }
+    int memory() const { return d.faces.totalCost(); }
+    int hits() const { return d.hits; }
+    int misses() const { return d.misses; }
+    void resetCounters() { d.hits = d.misses = 0; }
+private:
+    struct Data {
+        QCache<Key, QPixmap> faces;
+        int hits, misses;
+    } d;
+};
+
+uint qHash(const FaceAtlas::Key &key);
+
+struct FaceRequest {
+    FaceAtlas::Key key;
+    QFont font;
+    QPalette palette;
+};
+
 class Item : public QGraphicsWidget
 {
     Q_OBJECT
@@ -11,15 +103,21 @@ class Item : public QGraphicsWidget
     Q_PROPERTY(QColor color READ color WRITE setColor)
     Q_PROPERTY(QString text READ text WRITE setText)
     Q_PROPERTY(qreal yRotation READ yRotation WRITE setYRotation)
+    Q_PROPERTY(QRectF visualGeometry READ visualGeometry WRITE setVisualGeometry)
 public:
     Item();
+    ~Item();
     enum { Type = QGraphicsItem::UserType + 1 };
     virtual int type() const { return Type; }
     void paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget = 0);
     qreal yRotation() const;
-    void setYRotation(qreal yy);
+    virtual void setYRotation(qreal yy);
+    QRectF visualGeometry() const;
+    void setVisualGeometry(const QRectF &rect);
     void setText(const QString &text);
     QString text() const;
+    void setRevealRange(int start, int length);
+    void clearRevealRange() { setRevealRange(0, -1); }
     void setBackgroundColor(const QColor &color);
     QColor backgroundColor() const;
     void setColor(const QColor &color);
@@ -30,14 +128,44 @@ public:
     virtual void hoverLeaveEvent(QGraphicsSceneHoverEvent *event);
     virtual QVariant itemChange(GraphicsItemChange change, const QVariant &value);
     void setAcceptHoverEvents(bool enabled); // override
+    FaceRequest faceRequest(const QSize &size, bool hovered) const;
+    static QImage renderFaceImage(const FaceRequest &request);
+    int paintCount() const { return d.paintCount; }
+    qint64 paintTime() const { return d.paintTime; } // only with --stats
 signals:
     void clicked(Item *item, const QPointF &scenePos);
+    void hovered(Item *item);
+protected:
+    virtual void resizeEvent(QGraphicsSceneResizeEvent *event);
+    virtual void moveEvent(QGraphicsSceneMoveEvent *event);
+    virtual void changeEvent(QEvent *event);
+    QPixmap renderFace(const QString &text, const QSize &size, bool hovered = false) const;
+    void paintItem(QPainter *painter, const QStyleOptionGraphicsItem *option);
+    void recordPaint(qint64 nsecs);
 private:
+    enum { Margin = 5 };
+    void updateTransform();
+    QTextLayout *textLayout(const QSize &size);
+    void invalidateTextLayout();
+    const QPixmap &face(const QSize &size, bool hovered);
+    void invalidateFaces();
+    void paintFace(QPainter *painter, const QRect &rect, const QTextLayout *layout, bool hovered, bool reveal) const;
+    static void drawFace(QPainter *painter, const QRect &rect, const QPalette &palette,
+                         const QColor &background, const QColor &color,
+                         const QTextLayout *layout, bool hovered);
+    void drawRevealed(QPainter *painter, const QTextLayout *layout, const QPointF &offset) const;
+
     struct Data {
         QString text;
+        int revealStart, revealLength;
         qreal yRotation;
+        QRectF visualGeometry;
         bool hovered;
         QColor backgroundColor, color;
+        TextLayoutCache::Key layoutKey;
+        QPixmap faces[2];
+        int paintCount;
+        qint64 paintTime;
     } d;
 //    friend class GraphicsScene;
 };
@@ -71,15 +199,24 @@ public:
     QString answer() const { return d.answer; }
     void setAnswer(const QString &answer) { d.answer = answer; }
 
-#ifdef QT_DEBUG
+    bool cardMode() const { return d.cardMode; }
+    void setCardMode(bool on) { d.cardMode = on; }
+    void prepareCard(const QString &back, const QSize &faceSize);
+    virtual void setYRotation(qreal yy);
+
     void paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget = 0);
-#endif
 private:
+    enum Face { Front, Back };
     struct Data {
         QString question, answer, valueString;
         int value;
         int row, column;
         Status status;
+        bool cardMode;
+        QString cardBack;
+        QSize cardSize;
+        QPixmap faces[2];
+        Face face;
     } d;
 };
 
@@ -110,6 +247,7 @@ class Proxy : public QObject
     Q_PROPERTY(qreal yRotation READ yRotation WRITE setYRotation)
     Q_PROPERTY(QString text READ text WRITE setText)
     Q_PROPERTY(QRectF geometry READ geometry WRITE setGeometry)
+    Q_PROPERTY(QRectF visualGeometry READ visualGeometry WRITE setVisualGeometry)
     Q_PROPERTY(QColor backgroundColor READ backgroundColor WRITE setBackgroundColor)
     Q_PROPERTY(QColor color READ color WRITE setColor)
     Q_PROPERTY(bool activeFrame READ hasActiveFrame WRITE setActiveFrame)
@@ -131,6 +269,9 @@ public:
     QRectF geometry() const { return d.activeFrame ? d.activeFrame->geometry() : QRectF(); }
     void setGeometry(const QRectF &tt) { if (d.activeFrame) d.activeFrame->setGeometry(tt); }
 
+    QRectF visualGeometry() const { return d.activeFrame ? d.activeFrame->visualGeometry() : QRectF(); }
+    void setVisualGeometry(const QRectF &tt) { if (d.activeFrame) d.activeFrame->setVisualGeometry(tt); }
+
     Frame *activeFrame() const { return d.activeFrame; }
     void setActiveFrame(Frame *frame)
     {
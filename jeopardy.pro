@@ -8,8 +8,8 @@ DEPENDPATH += .
 INCLUDEPATH += .
 
 # Input
-HEADERS += scene.h view.h items.h
-SOURCES += scene.cpp view.cpp main.cpp items.cpp
+HEADERS += scene.h view.h items.h stats.h gameparser.h gameloader.h binarygame.h batch.h random.h gamemodel.h stateengine.h journal.h arguments.h
+SOURCES += scene.cpp view.cpp main.cpp items.cpp stats.cpp gameparser.cpp gameloader.cpp binarygame.cpp batch.cpp random.cpp gamemodel.cpp stateengine.cpp journal.cpp arguments.cpp
 CONFIG += debug
 unix {
     MOC_DIR=.moc
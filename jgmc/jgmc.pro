@@ -0,0 +1,20 @@
+TEMPLATE = app
+TARGET = jgmc
+DEPENDPATH += . ..
+INCLUDEPATH += . ..
+
+# Input
+HEADERS += ../gameloader.h ../gameparser.h ../binarygame.h ../random.h ../arguments.h
+SOURCES += main.cpp ../gameloader.cpp ../gameparser.cpp ../binarygame.cpp ../random.cpp ../arguments.cpp
+CONFIG += debug
+unix {
+    MOC_DIR=.moc
+    UI_DIR=.ui
+    OBJECTS_DIR=.obj
+} else {
+    MOC_DIR=tmp/moc
+    UI_DIR=tmp/ui
+    OBJECTS_DIR=tmp/obj
+}
+QT = script core
+CONFIG -= app_bundle
@@ -0,0 +1,59 @@
+#include <QtCore>
+#include <stdio.h>
+#include "gameloader.h"
+#include "binarygame.h"
+
+// Compiles .jgm and .js games into .jgmb files. JavaScript games are
+// evaluated once at compile time, so every load of the output has the
+// same questions.
+int main(int argc, char **argv)
+{
+    QCoreApplication a(argc, argv);
+    const QStringList args = a.arguments();
+    if (args.size() < 2 || args.size() > 3) {
+        fprintf(stderr, "Usage: %s input.jgm|input.js [output.jgmb]\n", argv[0]);
+        return 1;
+    }
+    const QString input = args.at(1);
+    QString output = args.value(2);
+    if (output.isEmpty())
+        output = QFileInfo(input).completeBaseName() + QLatin1String(".jgmb");
+
+    QFile in(input);
+    if (!in.open(QIODevice::ReadOnly)) {
+        fprintf(stderr, "Can't open %s for reading\n", qPrintable(input));
+        return 1;
+    }
+    GameLoader *loader = GameLoader::loaderFor(&in);
+    if (!loader) {
+        fprintf(stderr, "Unknown game format %s\n", qPrintable(input));
+        return 1;
+    }
+    GameData game;
+    QString error;
+    if (!loader->load(&in, &game, &error, 0)) {
+        fprintf(stderr, "Can't load %s: %s\n", qPrintable(input), qPrintable(error));
+        return 1;
+    }
+
+    // Compiled games have every question up front
+    if (!generateFrames(&game, &error)) {
+        fprintf(stderr, "%s: %s\n", qPrintable(input), qPrintable(error));
+        return 1;
+    }
+
+    QFile out(output);
+    if (!out.open(QIODevice::WriteOnly|QIODevice::Truncate)) {
+        fprintf(stderr, "Can't open %s for writing\n", qPrintable(output));
+        return 1;
+    }
+    if (!BinaryGameLoader::write(&out, game, &error)) {
+        fprintf(stderr, "Can't write %s: %s\n", qPrintable(output), qPrintable(error));
+        out.remove();
+        return 1;
+    }
+    printf("%s: %d categories, %d frames (%s loader) -> %s, %lld bytes\n",
+           qPrintable(input), game.categories.size(), game.frames.size(),
+           qPrintable(loader->name()), qPrintable(output), out.size());
+    return 0;
+}
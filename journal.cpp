@@ -0,0 +1,181 @@
+#include "journal.h"
+#include <string.h>
+
+class Journal::Writer : public QThread
+{
+public:
+    Writer(Journal *journal) : journal(journal) {}
+
+    virtual void run()
+    {
+        while (!journal->d.stop) {
+            journal->drain();
+            msleep(FlushInterval);
+        }
+        // Whatever was recorded before close()
+        journal->drain();
+    }
+private:
+    Journal *journal;
+};
+
+Journal::Journal(QObject *parent)
+    : QObject(parent)
+{
+    d.writer = 0;
+    d.state = NumStates;
+}
+
+Journal::~Journal()
+{
+    close();
+}
+
+bool Journal::open(const QString &fileName, QString *error)
+{
+    close();
+    d.file.setFileName(fileName);
+    if (!d.file.open(QIODevice::ReadWrite|QIODevice::Append)) {
+        if (error)
+            *error = d.file.errorString();
+        return false;
+    }
+
+    // An existing journal keeps its header, what we write goes after the
+    // last complete record with timestamps still counting from its start
+    JournalHeader header;
+    qint64 size = d.file.size();
+    if (size) {
+        if (size < qint64(sizeof(header)) || !d.file.seek(0)
+            || d.file.read(reinterpret_cast<char*>(&header), sizeof(header)) != sizeof(header)
+            || memcmp(header.magic, "JGMJ", 4) || header.byteOrder != JournalHeader::ByteOrder
+            || header.version != JournalHeader::Version || header.recordSize != sizeof(JournalRecord)) {
+            if (error)
+                *error = tr("%1 is not a journal written by this version").arg(fileName);
+            d.file.close();
+            return false;
+        }
+        const qint64 records = (size - sizeof(header)) / sizeof(JournalRecord);
+        size = sizeof(header) + (records * sizeof(JournalRecord));
+        if (size != d.file.size() && !d.file.resize(size)) {
+            if (error)
+                *error = d.file.errorString();
+            d.file.close();
+            return false;
+        }
+    } else {
+        memcpy(header.magic, "JGMJ", 4);
+        header.byteOrder = JournalHeader::ByteOrder;
+        header.version = JournalHeader::Version;
+        header.recordSize = sizeof(JournalRecord);
+        header.startTime = QDateTime::currentMSecsSinceEpoch();
+        if (d.file.write(reinterpret_cast<const char*>(&header), sizeof(header)) != sizeof(header) || !d.file.flush()) {
+            if (error)
+                *error = d.file.errorString();
+            d.file.close();
+            return false;
+        }
+    }
+
+    d.clock.start();
+    d.clockOffset = qMax<qint64>(0, QDateTime::currentMSecsSinceEpoch() - header.startTime) * 1000000;
+    d.head = 0;
+    d.tail = 0;
+    d.dropped = 0;
+    d.stop = 0;
+    d.writer = new Writer(this);
+    d.writer->start(QThread::LowPriority);
+    return true;
+}
+
+void Journal::close()
+{
+    if (!d.writer)
+        return;
+    d.stop = 1;
+    d.writer->wait();
+    delete d.writer;
+    d.writer = 0;
+    d.file.close();
+    if (d.dropped)
+        qWarning("Journal %s dropped %d records", qPrintable(d.file.fileName()), int(d.dropped));
+}
+
+void Journal::attach(GameModel *model)
+{
+    if (d.model)
+        disconnect(d.model, 0, this, 0);
+    d.model = model;
+    d.state = model->state();
+    connect(model, SIGNAL(gameStarted()), this, SLOT(onGameStarted()));
+    connect(model, SIGNAL(stateChanged(StateType)), this, SLOT(onStateChanged(StateType)));
+    connect(model, SIGNAL(pointsChanged(int, int)), this, SLOT(onPointsChanged(int, int)));
+}
+
+void Journal::record(JournalRecord::Type type, int state, int team, int value)
+{
+    if (!d.writer)
+        return;
+    // Only this thread moves head, so it can be read without a barrier
+    const quint32 head = d.head;
+    const quint32 tail = d.tail.fetchAndAddAcquire(0);
+    if (head - tail >= quint32(Capacity)) {
+        d.dropped.ref();
+        return;
+    }
+    JournalRecord &record = d.ring[head & (Capacity - 1)];
+    record.timestamp = d.clockOffset + d.clock.nsecsElapsed();
+    record.type = type;
+    record.state = state;
+    record.team = team;
+    record.value = value;
+    d.head.fetchAndStoreRelease(head + 1);
+}
+
+// Called on the writer thread. Writes everything in the ring at most in
+// two pieces, it only wraps once.
+bool Journal::drain()
+{
+    const quint32 head = d.head.fetchAndAddAcquire(0);
+    quint32 tail = d.tail;
+    if (head == tail)
+        return true;
+    while (tail != head) {
+        const quint32 start = tail & (Capacity - 1);
+        const quint32 count = qMin<quint32>(head - tail, Capacity - start);
+        const qint64 size = count * sizeof(JournalRecord);
+        if (d.file.write(reinterpret_cast<const char*>(d.ring + start), size) != size) {
+            qWarning("Can't write journal %s: %s", qPrintable(d.file.fileName()),
+                     qPrintable(d.file.errorString()));
+            d.tail.fetchAndStoreRelease(head);
+            return false;
+        }
+        tail += count;
+        d.tail.fetchAndStoreRelease(tail);
+    }
+    return d.file.flush();
+}
+
+void Journal::onGameStarted()
+{
+    Q_ASSERT(d.model);
+    d.state = d.model->state();
+    record(JournalRecord::GameStarted, d.state, d.model->teamCount(), d.model->frameCount());
+}
+
+void Journal::onStateChanged(StateType state)
+{
+    Q_ASSERT(d.model);
+    if (state == ShowQuestion && d.state == Normal) {
+        record(JournalRecord::FramePicked, state, -1, d.model->currentFrame());
+    } else if (state == PickRightOrWrong) {
+        record(JournalRecord::TeamChosen, state, d.model->activeTeam(), -1);
+    }
+    record(JournalRecord::StateEntered, state, d.model->activeTeam(), d.model->currentFrame());
+    d.state = state;
+}
+
+void Journal::onPointsChanged(int team, int points)
+{
+    record(JournalRecord::PointsChanged, d.model ? d.model->state() : d.state, team, points);
+}
@@ -0,0 +1,94 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <QtCore>
+#include "gamemodel.h"
+
+// Journals (.jgmj) are append-only, opening an existing one adds to it.
+// Like compiled games everything is in the byte order of the machine that
+// wrote them:
+//
+// JournalHeader
+// JournalRecord records[]                until the end of the file
+//
+// Timestamps are nanoseconds since JournalHeader::startTime, when the file
+// was created. Within a session they come from the monotonic clock.
+struct JournalHeader
+{
+    enum {
+        Version = 1,
+        ByteOrder = 0x01020304
+    };
+
+    char magic[4];
+    quint32 byteOrder;
+    quint32 version;
+    quint32 recordSize;
+    qint64 startTime; // msecs since the epoch
+};
+
+struct JournalRecord
+{
+    enum Type {
+        GameStarted,    // team is the number of teams, value the number of frames
+        StateEntered,   // team and value are the active team and frame, -1 for none
+        FramePicked,    // value is the frame
+        TeamChosen,     // team
+        PointsChanged   // team, value is the new score
+    };
+
+    qint64 timestamp;
+    quint8 type;
+    quint8 state;
+    qint16 team;
+    qint32 value;
+};
+
+// Records what happens to a GameModel. record() is called on the model's
+// thread and only ever copies the record into a ring buffer, a writer
+// thread takes them out and writes them to disk. There is one producer
+// and one consumer so the ring needs no lock. When the writer falls
+// behind by a whole ring, records are dropped and counted rather than
+// waited for.
+class Journal : public QObject
+{
+    Q_OBJECT
+public:
+    Journal(QObject *parent = 0);
+    ~Journal();
+
+    bool open(const QString &fileName, QString *error);
+    void close();
+    bool isOpen() const { return d.writer != 0; }
+
+    void attach(GameModel *model);
+    void record(JournalRecord::Type type, int state, int team, int value);
+    int dropped() const { return d.dropped; }
+private slots:
+    void onGameStarted();
+    void onStateChanged(StateType state);
+    void onPointsChanged(int team, int points);
+private:
+    class Writer;
+    friend class Writer;
+    enum {
+        Capacity = 4096, // records, a power of two
+        FlushInterval = 50 // ms
+    };
+    bool drain();
+
+    struct Data {
+        QFile file;
+        Writer *writer;
+        QPointer<GameModel> model;
+        StateType state;
+        QElapsedTimer clock;
+        qint64 clockOffset;
+        JournalRecord ring[Capacity];
+        // Written by the producer and the writer respectively
+        QAtomicInt head, tail;
+        QAtomicInt dropped, stop;
+    } d;
+};
+
+#endif
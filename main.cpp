@@ -1,9 +1,14 @@
 #include <QtGui>
 #include "view.h"
+#include "batch.h"
+#include <string.h>
 
 int main(int argc, char **argv)
 {
-    srand(QDateTime::currentDateTime().toMSecsSinceEpoch());
+    for (int i=1; i<argc; ++i) {
+        if (!strncmp(argv[i], "--generate=", 11))
+            return generateBoards(argc, argv);
+    }
 
     QApplication a(argc, argv);
     a.setOrganizationName(QLatin1String("AndersSoft"));
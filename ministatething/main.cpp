@@ -1,254 +1,342 @@
-#include <QtGui>
+#include <QtCore>
+#include <stdio.h>
+#include <string.h>
+#include "gamemodel.h"
+#include "stateengine.h"
+#include "random.h"
+#include "allocations.h"
+#include "arguments.h"
 
-class Object : public QObject
+// Plays random games on a GameModel as fast as it will go. The states the
+// model goes through are followed by one of the engines a view can use:
+//
+// model   nothing, just the rules
+// table   StateEngine
+// qt      QStateMachine, which needs the event loop to catch up
+class Benchmark : public QObject
 {
     Q_OBJECT
 public:
-    enum StateType {
-        Normal = 0,
-        ShowQuestion,
-        TimeOut,
-        PickTeam,
-        TeamTimedOut,
-        PickRightOrWrong,
-        WrongAnswer,
-        RightAnswer,
-        Finished,
-        NumStates
+    enum Engine {
+        ModelEngine,
+        TableEngine,
+        QtEngine
     };
 
-    Object(QObject *parent = 0)
-        : QObject(parent)
+    Benchmark(Engine engine, quint64 seed)
+        : QObject(), d(seed)
     {
-        d.right = d.wrong = d.timedout = 0;
-        d.framesLeft = 0;
-        d.currentFrame = 0;
-        d.currentTeam = 0;
-
-        const char *states[] = {
-            "Normal", "ShowQuestion", "TimeOut", "PickTeam",
-            "TeamTimedOut", "PickRightOrWrong", "WrongAnswer",
-            "RightAnswer", "Finished", 0
-        };
-        for (int i=0; states[i]; ++i) {
-            QState *state = new QState(&d.stateMachine);
-            state->setProperty("type", i);
-            connect(state, SIGNAL(entered()), this, SLOT(onStateEntered()));
-            connect(state, SIGNAL(exited()), this, SLOT(onStateExited()));
-            state->setObjectName(states[i]);
-            d.states[i] = state;
-        }
+        d.engine = engine;
+        d.counting = false;
+        d.pending = 0;
+        d.state = NumStates;
+        d.last = 0;
+        memset(d.coverage, 0, sizeof(d.coverage));
+        connect(&d.model, SIGNAL(stateChanged(StateType)), this, SLOT(onModelStateChanged(StateType)));
 
-        d.states[Normal]->addTransition(this, SIGNAL(nextState()),
-                                        d.states[ShowQuestion]);
-        d.states[ShowQuestion]->addTransition(this, SIGNAL(nextStateTimeOut()),
-                                              d.states[TimeOut]);
-        d.states[ShowQuestion]->addTransition(this, SIGNAL(nextState()),
-                                              d.states[PickTeam]);
-        d.states[TimeOut]->addTransition(this, SIGNAL(nextState()),
-                                         d.states[Normal]);
-        d.states[TimeOut]->addTransition(this, SIGNAL(nextStateFinished()),
-                                         d.states[Finished]);
-        d.states[PickTeam]->addTransition(this, SIGNAL(nextStateTimeOut()),
-                                          d.states[TeamTimedOut]);
-        d.states[PickTeam]->addTransition(this, SIGNAL(nextState()),
-                                          d.states[PickRightOrWrong]);
-        d.states[TeamTimedOut]->addTransition(this, SIGNAL(nextState()),
-                                              d.states[ShowQuestion]);
-        d.states[PickRightOrWrong]->addTransition(this, SIGNAL(nextStateRight()),
-                                                  d.states[RightAnswer]);
-        d.states[PickRightOrWrong]->addTransition(this, SIGNAL(nextStateWrong()),
-                                                  d.states[WrongAnswer]);
-        d.states[RightAnswer]->addTransition(this, SIGNAL(nextState()),
-                                             d.states[Normal]);
-        d.states[RightAnswer]->addTransition(this, SIGNAL(nextStateFinished()),
-                                             d.states[Finished]);
-        d.states[WrongAnswer]->addTransition(this, SIGNAL(nextState()),
-                                             d.states[ShowQuestion]);
+        for (int i=0; i<NumStates; ++i) {
+            const StateType type = static_cast<StateType>(i);
+            const QVariant name = QString::fromLatin1(GameModel::stateName(type));
+            if (engine == TableEngine) {
+                d.table.assignProperty(type, &d.target, "objectName", name);
+            } else if (engine == QtEngine) {
+                d.states[i] = new State(type, &d.stateMachine);
+                d.states[i]->assignProperty(&d.target, "objectName", name);
+                connect(d.states[i], SIGNAL(entered()), this, SLOT(onStateEntered()));
+            }
+        }
+        if (engine == TableEngine) {
+            connect(this, SIGNAL(next(int)), &d.table, SLOT(next(int)));
+            connect(&d.table, SIGNAL(entered(StateType)), this, SLOT(onEntered(StateType)));
+        } else if (engine == QtEngine) {
+            for (int from=0; from<NumStates; ++from) {
+                for (int to=0; to<NumStates; ++to) {
+                    if (GameModel::isTransition(static_cast<StateType>(from), static_cast<StateType>(to)))
+                        d.states[from]->addTransition(static_cast<StateType>(to), new Transition(this, d.states[to]));
+                }
+            }
+            d.stateMachine.setInitialState(d.states[Normal]);
+        }
     }
 
-public slots:
-    void newGame()
+    void run(int games)
     {
-        d.right = d.wrong = d.timedout = 0;
-        qDeleteAll(d.teams);
-        d.teams.clear();
-        qDeleteAll(d.frames);
-        d.frames.clear();
-        d.currentTeam = 0;
-        d.currentFrame = 0;
-        d.teamsAttempted.clear();
-        for (int i=0; i<3; ++i) {
-            Team *team = new Team;
-            team->name = QString("Team %1").arg(i + 1);
-            team->score = 0;
-            d.teams.append(team);
+        d.latencies.clear();
+        d.latencies.reserve(games * 128);
+        d.clock.start();
+        const int before = allocationCount();
+        for (int i=0; i<games; ++i) {
+            newGame();
+            d.counting = true;
+            while (d.model.state() != Finished) {
+                d.last = d.clock.nsecsElapsed();
+                next();
+                while (d.pending)
+                    QCoreApplication::processEvents();
+            }
+            d.counting = false;
         }
+        d.elapsed = d.clock.nsecsElapsed();
+        d.allocations = allocationCount() - before;
+        d.games = games;
+    }
 
-        for (int i=0; i<20; ++i) {
-            Frame *frame = new Frame;
-            frame->value = ((i / 5) + 1) * 100;
-            frame->question = QString("Question %1/%2 %3$").arg(i / 5).arg(i % 5).arg(frame->value);
-            frame->status = Frame::Hidden;
-            d.frames.append(frame);
+    void report(const QList<QPair<StateType, StateType> > &graph) const
+    {
+        static const char *engines[] = { "model", "table", "qt" };
+        const int transitions = d.latencies.size();
+        QVector<qint64> latencies = d.latencies;
+        qSort(latencies);
+        const double seconds = double(d.elapsed) / 1000000000.0;
+        printf("engine %s, %d games, %d transitions in %.3f s\n", engines[d.engine], d.games, transitions, seconds);
+        if (!transitions)
+            return;
+        printf("%14.0f transitions/s\n%14.0f games/s\n", transitions / seconds, d.games / seconds);
+        printf("%14lld nsecs p50\n%14lld nsecs p99\n", latencies.at(transitions / 2),
+               latencies.at((transitions * 99) / 100));
+        printf("%14.2f allocations/transition\n\n", double(d.allocations) / transitions);
+
+        bool known[NumStates][NumStates];
+        memset(known, 0, sizeof(known));
+        int covered = 0;
+        printf("%-34s %12s\n", graph.isEmpty() ? "transition" : "transition in states.txt", "count");
+        for (int i=0; i<graph.size(); ++i) {
+            const StateType from = graph.at(i).first;
+            const StateType to = graph.at(i).second;
+            known[from][to] = true;
+            const QString edge = QString("%1 -> %2").arg(GameModel::stateName(from), GameModel::stateName(to));
+            printf("%-34s %12llu%s\n", qPrintable(edge), d.coverage[from][to],
+                   d.coverage[from][to] ? "" : "  never taken");
+            if (d.coverage[from][to])
+                ++covered;
+        }
+        bool header = false;
+        for (int from=0; from<NumStates; ++from) {
+            for (int to=0; to<NumStates; ++to) {
+                if (known[from][to] || !d.coverage[from][to])
+                    continue;
+                if (!header) {
+                    printf("%-34s %12s\n", graph.isEmpty() ? "" : "not in states.txt", "");
+                    header = true;
+                }
+                const QString edge = QString("%1 -> %2").arg(GameModel::stateName(static_cast<StateType>(from)),
+                                                             GameModel::stateName(static_cast<StateType>(to)));
+                printf("%-34s %12llu\n", qPrintable(edge), d.coverage[from][to]);
+            }
         }
-        d.framesLeft = d.frames.size();
-        d.stateMachine.setInitialState(d.states[Normal]);
-        d.stateMachine.start();
-        QTimer::singleShot(0, this, SLOT(next()));
+        if (!graph.isEmpty())
+            printf("\n%d of %d transitions in states.txt taken\n", covered, graph.size());
     }
-    void next()
+
+signals:
+    void next(int type);
+private slots:
+    void onModelStateChanged(StateType state)
     {
-        switch (rand() % 4) {
-        case 0: emit nextState(); break;
-        case 1: emit nextStateWrong(); break;
-        case 2: emit nextStateRight(); break;
-        case 3: emit nextStateTimeOut(); break;
+        if (d.engine == ModelEngine) {
+            onEntered(state);
+        } else {
+            ++d.pending;
+            emit next(state);
         }
-        QTimer::singleShot(0, this, SLOT(next()));
     }
     void onStateEntered()
     {
-        QState *state = qobject_cast<QState*>(sender());
-        const int type = state->property("type").toInt();
-        switch (type) {
-        case Normal:
-            Q_ASSERT(d.teamsAttempted.isEmpty());
-            Q_ASSERT(!d.currentTeam);
-            Q_ASSERT(!d.currentFrame);
-            break;
-        case ShowQuestion: {
-            if (d.teamsAttempted.size() == d.teams.size()) {
-                emit nextStateTimeOut();
-            } else {
-                Q_ASSERT(d.currentFrame);
-//                 qDebug() << "showing question" << d.currentFrame->question
-//                          << "worth" << d.currentFrame->value << "$";
+        onEntered(static_cast<State*>(sender())->type());
+    }
+    void onEntered(StateType state)
+    {
+        if (d.counting) {
+            const qint64 now = d.clock.nsecsElapsed();
+            d.latencies.append(now - d.last);
+            d.last = now;
+            ++d.coverage[d.state][state];
+        }
+        if (d.pending)
+            --d.pending;
+        d.state = state;
+    }
+private:
+    void newGame()
+    {
+        QStringList categories;
+        QList<QPair<QString, QString> > frames;
+        for (int i=0; i<4; ++i) {
+            categories.append(QString("Category %1").arg(i + 1));
+            for (int j=0; j<GameModel::QuestionsPerCategory; ++j) {
+                frames.append(qMakePair(QString("Question %1/%2 %3$").arg(i).arg(j).arg((j + 1) * 100),
+                                        QString("Answer %1/%2").arg(i).arg(j)));
             }
-            break; }
-        case TimeOut:
-            Q_ASSERT(d.currentFrame);
-            d.currentFrame->status = Frame::Failed;
-            finishQuestion();
-            break;
-        case PickTeam:
-            Q_ASSERT(!d.currentTeam);
-            Q_ASSERT(d.teamsAttempted.size() < d.teams.size());
-            do {
-                d.currentTeam = d.teams.at(rand() % d.teams.size());
-            } while (d.teamsAttempted.contains(d.currentTeam));
-            d.teamsAttempted.insert(d.currentTeam);
-            break;
-        case TeamTimedOut:
-            ++d.timedout;
-        case WrongAnswer:
-            if (type == WrongAnswer)
-                ++d.wrong;
-            Q_ASSERT(d.currentTeam);
-            Q_ASSERT(d.currentFrame);
-            d.currentTeam->score -= d.currentFrame->value / 2;
-//             qDebug() << d.currentTeam->name
-//                      << (state->property("type").toInt() == TeamTimedOut
-//                          ? "Didn't answer in time" : "Answered wrong")
-//                      << "They lost" << (d.currentFrame->value / 2) << "$. They now have"
-//                      << d.currentTeam->score << "$";
-            d.currentTeam = 0;
+        }
+        QStringList teams;
+        for (int i=0; i<3; ++i)
+            teams.append(QString("Team %1").arg(i + 1));
+        d.model.setGame(categories, frames, teams);
+
+        // Back to Normal without counting it as a transition
+        switch (d.engine) {
+        case ModelEngine:
+            d.state = Normal;
             break;
-        case RightAnswer:
-            ++d.right;
-            Q_ASSERT(d.currentTeam);
-            Q_ASSERT(d.currentFrame);
-            d.currentTeam->score += d.currentFrame->value;
-//             qDebug() << d.currentTeam->name << "answered correctly and earned" << d.currentFrame->value
-//                      << "$. They now have" << d.currentTeam->score << "$";
-            finishQuestion();
+        case TableEngine:
+            d.table.setState(Normal);
             break;
-        case Finished:
-            qSort(d.teams.end(), d.teams.begin(), compareTeamsByScore);
-            for (int i=0; i<d.teams.size(); ++i) {
-                qDebug() << i << d.teams.at(i)->score << d.teams.at(i)->name;
+        case QtEngine:
+            if (d.stateMachine.isRunning()) {
+                d.stateMachine.stop();
+                while (d.stateMachine.isRunning())
+                    QCoreApplication::processEvents();
             }
-            qDebug() << "right" << d.right << "wrong" << d.wrong << "timedout" << d.timedout;
-            d.stateMachine.stop();
-            QTimer::singleShot(500, this, SLOT(newGame()));
+            d.state = NumStates;
+            d.stateMachine.start();
+            while (d.state != Normal)
+                QCoreApplication::processEvents();
             break;
         }
-//        qDebug() << sender()->objectName() << "entered";
     }
-    void onStateExited()
+    void next()
     {
-        QState *state = qobject_cast<QState*>(sender());
-        switch (state->property("type").toInt()) {
+        switch (d.model.state()) {
         case Normal: {
-            int idx = rand() % d.frames.size();
-            while (d.frames.at(idx)->status != Frame::Hidden) {
-                if (++idx == d.frames.size())
+            int idx = d.random.bounded(d.model.frameCount());
+            while (d.model.frameStatus(idx) != GameModel::Hidden) {
+                if (++idx == d.model.frameCount())
                     idx = 0;
             }
-            Q_ASSERT(!d.currentFrame);
-            d.currentFrame = d.frames.at(idx);
-            Q_ASSERT(d.currentFrame->status == Frame::Hidden);
-            --d.framesLeft;
+            d.model.pickFrame(idx);
             break; }
+        case ShowQuestion:
+            if (d.random.bounded(4)) {
+                d.model.stopClock();
+            } else {
+                d.model.timeOut();
+            }
+            break;
+        case PickTeam: {
+            if (!d.random.bounded(8)) {
+                d.model.noAnswers();
+                break;
+            }
+            int team;
+            do {
+                team = d.random.bounded(d.model.teamCount());
+            } while (d.model.hasAttempted(team));
+            d.model.pickTeam(team);
+            break; }
+        case PickRightOrWrong:
+            d.model.answer(d.random.bounded(2));
+            break;
+        case RightAnswer:
+            d.model.finishQuestion();
+            break;
         default:
+            Q_ASSERT(0);
             break;
         }
-//        qDebug() << sender()->objectName() << "exited";
     }
 
-signals:
-    void nextState();
-    void nextStateWrong();
-    void nextStateRight();
-    void nextStateTimeOut();
-    void nextStateFinished();
-private:
-    void finishQuestion()
-    {
-        d.currentFrame = 0;
-        d.teamsAttempted.clear();
-        d.currentTeam = 0;
-        if (d.framesLeft == 0)
-            emit nextStateFinished();
-    }
-    struct Team {
-        QString name;
-        int score;
-    };
-    static inline bool compareTeamsByScore(const Team *left, const Team *right)
-    {
-        return left->score < right->score;
-    }
-    struct Frame {
-        QString question;
-        int value;
-        enum Status {
-            Hidden,
-            Failed,
-            Succeeded
-        } status;
-    };
     struct Data {
-        QStateMachine stateMachine;
-        QState *states[NumStates];
-        QList<Team*> teams;
-        QSet<Team*> teamsAttempted;
-        Team *currentTeam;
+        Data(quint64 seed) : random(seed) {}
 
-        QList<Frame*> frames;
-        int framesLeft;
-        int right, wrong, timedout;
+        Engine engine;
+        GameModel model;
+        Random random;
+        QObject target;
+        StateEngine table;
+        QStateMachine stateMachine;
+        State *states[NumStates];
 
-        Frame *currentFrame;
+        bool counting;
+        int pending;
+        StateType state;
+        QElapsedTimer clock;
+        qint64 last, elapsed;
+        QVector<qint64> latencies;
+        int allocations, games;
+        quint64 coverage[NumStates][NumStates];
     } d;
 };
 
+static StateType stateType(const QString &name)
+{
+    for (int i=0; i<NumStates; ++i) {
+        if (!name.compare(QLatin1String(GameModel::stateName(static_cast<StateType>(i))), Qt::CaseInsensitive))
+            return static_cast<StateType>(i);
+    }
+    return NumStates;
+}
+
+// states.txt draws the graph as a tree. A line that starts with an arrow
+// continues from the state that the arrow in the same column on an
+// earlier line came from.
+static bool readGraph(const QString &fileName, QList<QPair<StateType, StateType> > *graph)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly|QIODevice::Text))
+        return false;
+    QHash<int, StateType> sources;
+    while (!file.atEnd()) {
+        const QString line = QString::fromUtf8(file.readLine());
+        if (line.trimmed().isEmpty() || line.trimmed().startsWith('#'))
+            continue;
+        StateType from = NumStates;
+        int pos = 0;
+        forever {
+            while (pos < line.size() && line.at(pos).isSpace())
+                ++pos;
+            if (pos >= line.size())
+                break;
+            if (line.midRef(pos, 2) == QLatin1String("->")) {
+                if (from == NumStates)
+                    from = sources.value(pos, NumStates);
+                if (from == NumStates)
+                    return false;
+                sources[pos] = from;
+                pos += 2;
+                continue;
+            }
+            const int start = pos;
+            while (pos < line.size() && !line.at(pos).isSpace())
+                ++pos;
+            const StateType state = stateType(line.mid(start, pos - start));
+            if (state == NumStates)
+                return false;
+            if (from != NumStates && !graph->contains(qMakePair(from, state)))
+                graph->append(qMakePair(from, state));
+            from = state;
+        }
+    }
+    return true;
+}
+
 #include "main.moc"
 
 int main(int argc, char **argv)
 {
     QCoreApplication a(argc, argv);
-    Object w;
-    w.newGame();
-    return a.exec();
+    const QStringList args = a.arguments();
+    const int iterations = argumentValue(args, "iterations", "10000").toInt();
+    const QString engineName = argumentValue(args, "engine", "table");
+    const char *engines[] = { "model", "table", "qt", 0 };
+    int engine = 0;
+    while (engines[engine] && engineName != QLatin1String(engines[engine]))
+        ++engine;
+    if (!engines[engine] || iterations <= 0) {
+        fprintf(stderr, "Usage: %s [--iterations=games] [--seed=S] [--engine=model|table|qt] [--states=states.txt]\n", argv[0]);
+        return 1;
+    }
+
+    QList<QPair<StateType, StateType> > graph;
+    const QString states = argumentValue(args, "states", a.applicationDirPath() + "/../states.txt");
+    if (!readGraph(states, &graph)) {
+        qWarning("Can't read the state graph from %s", qPrintable(states));
+        graph.clear();
+    }
+
+    const quint64 seed = Random::nextSeed();
+    printf("seed %llu\n", seed);
+    Benchmark benchmark(static_cast<Benchmark::Engine>(engine), seed);
+    benchmark.run(iterations);
+    benchmark.report(graph);
+    return 0;
 }
@@ -4,11 +4,12 @@
 
 TEMPLATE = app
 TARGET = 
-DEPENDPATH += .
-INCLUDEPATH += .
+DEPENDPATH += . ..
+INCLUDEPATH += . ..
 
 # Input
-SOURCES += main.cpp
+HEADERS += ../gamemodel.h ../stateengine.h ../random.h ../allocations.h ../arguments.h
+SOURCES += main.cpp ../gamemodel.cpp ../stateengine.cpp ../random.cpp ../allocations.cpp ../arguments.cpp
 CONFIG += debug
 unix {
     MOC_DIR=.moc
@@ -19,4 +20,5 @@ unix {
     UI_DIR=tmp/ui
     OBJECTS_DIR=tmp/obj
 }
+QT = core
 CONFIG -= app_bundle
@@ -0,0 +1,56 @@
+#include "random.h"
+
+quint64 Random::mix(quint64 value)
+{
+    value += Q_UINT64_C(0x9e3779b97f4a7c15);
+    value = (value ^ (value >> 30)) * Q_UINT64_C(0xbf58476d1ce4e5b9);
+    value = (value ^ (value >> 27)) * Q_UINT64_C(0x94d049bb133111eb);
+    return value ^ (value >> 31);
+}
+
+void Random::setSeed(quint64 seed)
+{
+    // splitmix64 never produces four zeros in a row, which is the one
+    // state xoshiro can't leave
+    for (int i=0; i<4; ++i) {
+        seed += Q_UINT64_C(0x9e3779b97f4a7c15);
+        d.s[i] = mix(seed);
+    }
+}
+
+quint32 Random::bounded(quint32 range)
+{
+    Q_ASSERT(range > 0);
+    // Lemire's multiply and shift, rejecting the few values that would
+    // make the low results more likely
+    quint64 m = quint64(quint32(next() >> 32)) * range;
+    if (quint32(m) < range) {
+        const quint32 threshold = quint32(-range) % range;
+        while (quint32(m) < threshold)
+            m = quint64(quint32(next() >> 32)) * range;
+    }
+    return quint32(m >> 32);
+}
+
+static bool seedArgument(quint64 *seed)
+{
+    foreach(const QString &arg, QCoreApplication::arguments()) {
+        if (arg.startsWith("--seed=")) {
+            bool ok;
+            *seed = arg.mid(7).toULongLong(&ok);
+            return ok;
+        }
+    }
+    return false;
+}
+
+quint64 Random::nextSeed()
+{
+    static QAtomicInt calls;
+    const int call = calls.fetchAndAddOrdered(1);
+    quint64 seed;
+    if (!call && seedArgument(&seed))
+        return seed;
+    return mix(quint64(QDateTime::currentMSecsSinceEpoch()) ^ (quint64(call) << 40)
+               ^ quint64(quintptr(&seed)));
+}
@@ -0,0 +1,45 @@
+#ifndef RANDOM_H
+#define RANDOM_H
+
+#include <QtCore>
+
+// xoshiro256** seeded through splitmix64. Not thread-safe, every engine or
+// thread has its own. Boards are regenerable from the seed they were made
+// with.
+class Random
+{
+public:
+    Random(quint64 seed = 0) { setSeed(seed); }
+
+    void setSeed(quint64 seed);
+
+    inline quint64 next()
+    {
+        const quint64 result = rotl(d.s[1] * 5, 7) * 9;
+        const quint64 t = d.s[1] << 17;
+        d.s[2] ^= d.s[0];
+        d.s[3] ^= d.s[1];
+        d.s[1] ^= d.s[2];
+        d.s[0] ^= d.s[3];
+        d.s[2] ^= t;
+        d.s[3] = rotl(d.s[3], 45);
+        return result;
+    }
+
+    // Uniform in [0, range)
+    quint32 bounded(quint32 range);
+    // Uniform in [0, 1), the top 53 bits as a double
+    inline double uniform() { return double(next() >> 11) * (1.0 / 9007199254740992.0); }
+
+    static quint64 mix(quint64 value);
+    // --seed=N for the first call, fresh seeds after that
+    static quint64 nextSeed();
+private:
+    static inline quint64 rotl(quint64 x, int k) { return (x << k) | (x >> (64 - k)); }
+
+    struct Data {
+        quint64 s[4];
+    } d;
+};
+
+#endif
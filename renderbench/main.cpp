@@ -0,0 +1,198 @@
+#include <QtGui>
+#include <stdio.h>
+#ifdef Q_OS_UNIX
+#include <unistd.h>
+#endif
+#include "scene.h"
+
+static qint64 residentMemory()
+{
+#ifdef Q_OS_LINUX
+    QFile file("/proc/self/statm");
+    if (file.open(QIODevice::ReadOnly)) {
+        const QList<QByteArray> fields = file.readAll().split(' ');
+        if (fields.size() > 1)
+            return fields.at(1).toLongLong() * sysconf(_SC_PAGESIZE);
+    }
+#endif
+    return 0;
+}
+
+static inline double msecs(qint64 nsecs)
+{
+    return double(nsecs) / 1000000.0;
+}
+
+class RenderBench : public QObject
+{
+    Q_OBJECT
+public:
+    RenderBench(GraphicsScene *scene, const QSize &size)
+        : QObject()
+    {
+        d.scene = scene;
+        d.image = QImage(size, QImage::Format_ARGB32_Premultiplied);
+        d.current = 0;
+        connect(scene, SIGNAL(changed(QList<QRectF>)), this, SLOT(onChanged()));
+    }
+
+    bool run()
+    {
+        d.scene->setSceneRect(QRectF(QPointF(), d.image.size()));
+        if (!waitForLayout() || !waitFor(Normal))
+            return false;
+
+        const QList<Frame*> frames = d.scene->frames();
+        Team *team = d.scene->teams().value(0);
+        Q_ASSERT(team);
+        for (int i=0; i<frames.size(); ++i) {
+            Frame *frame = frames.at(i);
+            const bool last = (i + 1 == frames.size());
+            if (!click(frame, ShowQuestion, "flip")
+                || !click(frame, PickTeam, "show teams")
+                || !click(team, PickRightOrWrong, "team pick")
+                || !click(d.scene->rightAnswerItem(), RightAnswer, "right answer")
+                || !click(frame, last ? Finished : Normal, last ? "finish" : "lower")) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void report() const
+    {
+        printf("%-14s %6s %7s %10s %10s %12s %10s %10s\n", "transition", "count", "ticks",
+               "ms/frame", "worst ms", "paints/item", "max/item", "peak MB");
+        for (QMap<QByteArray, Transition>::const_iterator it = d.transitions.begin(); it != d.transitions.end(); ++it) {
+            const Transition &t = it.value();
+            printf("%-14s %6d %7d %10.3f %10.3f %12.2f %10d %10.1f\n", it.key().constData(), t.count, t.ticks,
+                   t.ticks ? msecs(t.renderTime) / t.ticks : 0.0, msecs(t.worst),
+                   double(t.paints) / qMax(1, t.items * t.count), t.maxItemPaints,
+                   double(t.peakMemory) / (1024.0 * 1024.0));
+        }
+    }
+public slots:
+    void onChanged()
+    {
+        if (!d.current)
+            return;
+        QElapsedTimer timer;
+        timer.start();
+        d.image.fill(0);
+        QPainter painter(&d.image);
+        d.scene->render(&painter, d.image.rect(), d.scene->sceneRect());
+        painter.end();
+        const qint64 elapsed = timer.nsecsElapsed();
+        ++d.current->ticks;
+        d.current->renderTime += elapsed;
+        d.current->worst = qMax(d.current->worst, elapsed);
+        d.current->peakMemory = qMax(d.current->peakMemory, residentMemory());
+    }
+private:
+    struct Transition {
+        Transition() : count(0), ticks(0), items(0), paints(0), maxItemPaints(0),
+                       renderTime(0), worst(0), peakMemory(0) {}
+        int count, ticks, items, paints, maxItemPaints;
+        qint64 renderTime, worst, peakMemory;
+    };
+
+    QList<Item*> items() const
+    {
+        QList<Item*> ret;
+        foreach(QGraphicsItem *item, d.scene->items()) {
+            if (Item *it = qobject_cast<Item*>(item->toGraphicsObject()))
+                ret.append(it);
+        }
+        return ret;
+    }
+
+    bool click(Item *item, StateType state, const char *name)
+    {
+        const QList<Item*> all = items();
+        QVector<int> paints(all.size());
+        for (int i=0; i<all.size(); ++i)
+            paints[i] = all.at(i)->paintCount();
+
+        d.current = &d.transitions[name];
+        ++d.current->count;
+        d.current->items = all.size();
+        d.scene->onClicked(item);
+        const bool ok = waitFor(state);
+        d.current = 0;
+
+        Transition &t = d.transitions[name];
+        for (int i=0; i<all.size(); ++i) {
+            const int count = all.at(i)->paintCount() - paints.at(i);
+            t.paints += count;
+            t.maxItemPaints = qMax(t.maxItemPaints, count);
+        }
+        if (!ok)
+            fprintf(stderr, "Timed out waiting for %s\n", name);
+        return ok;
+    }
+
+    bool waitForLayout()
+    {
+        QElapsedTimer timer;
+        timer.start();
+        while (d.scene->isLayoutPending()) {
+            if (timer.elapsed() > Timeout)
+                return false;
+            QCoreApplication::processEvents(QEventLoop::WaitForMoreEvents);
+        }
+        return true;
+    }
+
+    bool waitFor(StateType state)
+    {
+        QElapsedTimer timer;
+        timer.start();
+        while (d.scene->currentStateType() != state || d.scene->isAnimating()) {
+            if (timer.elapsed() > Timeout)
+                return false;
+            QCoreApplication::processEvents(QEventLoop::WaitForMoreEvents);
+        }
+        return true;
+    }
+
+    enum { Timeout = 30000 };
+    struct Data {
+        GraphicsScene *scene;
+        QImage image;
+        QMap<QByteArray, Transition> transitions;
+        Transition *current;
+    } d;
+};
+
+#include "main.moc"
+
+int main(int argc, char **argv)
+{
+    // Everything is rendered into a QImage and no window is ever shown
+    QApplication::setGraphicsSystem("raster");
+    QApplication a(argc, argv);
+    QString file;
+    QSize size(1920, 1080);
+    foreach(const QString &arg, a.arguments().mid(1)) {
+        if (arg.startsWith("--size=")) {
+            const QStringList split = arg.mid(7).split('x');
+            size = QSize(split.value(0).toInt(), split.value(1).toInt());
+        } else if (QFile::exists(arg)) {
+            file = arg;
+        }
+    }
+    if (file.isEmpty() || size.isEmpty()) {
+        fprintf(stderr, "Usage: %s [--size=WxH] [--card-flip] [--zoom-transform] game.jgm|game.js\n", argv[0]);
+        return 1;
+    }
+
+    GraphicsScene scene;
+    if (!scene.load(file, QStringList() << "Team 1" << "Team 2" << "Team 3")) {
+        fprintf(stderr, "Can't load %s\n", qPrintable(file));
+        return 1;
+    }
+    RenderBench bench(&scene, size);
+    const bool ok = bench.run();
+    bench.report();
+    return ok ? 0 : 1;
+}
@@ -1,21 +1,39 @@
 #include "scene.h"
-#include <QtScript>
+#include "gameloader.h"
+#include "stats.h"
 
+// Item sizes are rounded down to a multiple of this so that a window
+// drag doesn't throw away every face and text layout for each pixel
+enum { SizeBucket = 8 };
+
+static inline QSizeF snapped(const QSizeF &size)
+{
+    return QSizeF(int(size.width()) / SizeBucket * SizeBucket,
+                  int(size.height()) / SizeBucket * SizeBucket);
+}
+
+static inline QRectF snapped(const QRectF &rect)
+{
+    return QRectF(QPointF(qRound(rect.x()), qRound(rect.y())), ::snapped(rect.size()));
+}
+
+// The grid is snapped as a whole. Every cell gets the same bucketed size
+// and sits at the grid's origin plus its index times that size, so
+// neighbours stay flush instead of each cell losing its own remainder.
 static inline QRectF itemGeometry(int row, int column, int rows, int columns, const QRectF &sceneRect)
 {
     if (qMin(rows, columns) <= 0)
         return QRectF();
-    QRectF r(0, 0, sceneRect.width() / columns, sceneRect.height() / rows);
-    r.moveLeft((r.width() * column) + sceneRect.left() );
-    r.moveTop((r.height() * row) + sceneRect.top());
-    return r;
+    const QSizeF size = ::snapped(QSizeF(sceneRect.width() / columns, sceneRect.height() / rows));
+    const QPointF origin(qRound(sceneRect.left()), qRound(sceneRect.top()));
+    return QRectF(origin + QPointF(size.width() * column, size.height() * row), size);
 }
 
 static inline QRectF raisedGeometry(const QRectF &sceneRect)
 {
     static qreal adjust = .1;
-    return sceneRect.adjusted(sceneRect.width() * adjust, sceneRect.height() * adjust,
-                              -sceneRect.width() * adjust, -sceneRect.height() * adjust);
+    return ::snapped(sceneRect.adjusted(sceneRect.width() * adjust, sceneRect.height() * adjust,
+                                        -sceneRect.width() * adjust, -sceneRect.height() * adjust));
 }
 
 class TextAnimation : public QPropertyAnimation
@@ -23,9 +41,17 @@ class TextAnimation : public QPropertyAnimation
 public:
     TextAnimation(QObject *o, const QByteArray &propertyName)
         : QPropertyAnimation(o, propertyName)
-    {}
+    {
+        d.revealStart = 0;
+        d.revealLength = -1;
+    }
+    // The animation only ever hands out one of the two end points. The
+    // final text is laid out once and each tick just moves the range of
+    // it that the item draws.
     virtual QVariant interpolated(const QVariant &from, const QVariant &to, qreal progress) const
     {
+        d.revealStart = 0;
+        d.revealLength = -1;
         if (qFuzzyIsNull(progress)) {
             return from;
         } else if (qFuzzyCompare(progress, 1.0)) {
@@ -34,33 +60,44 @@ public:
             return from;
         }
 
-#if 0
-        if (progress < .5) {
-            QString fromString = from.toString();
-            const int letters = fromString.size() * (progress * 2);
-            fromString.chop(letters);
-            return fromString;
-        } else {
-            const QString toString = to.toString();
-            const int letters = toString.size() * ((progress - 0.5) * 2);
-            return toString.mid(letters);
+        const int fromSize = from.toString().size();
+        const int toSize = to.toString().size();
+        const int current = (fromSize + toSize) * progress;
+        if (current <= fromSize) {
+            d.revealLength = fromSize - current;
+            return from;
         }
-#else
-        QString fromString = from.toString();
-        const QString toString = to.toString();
-        const int letters = fromString.size() + toString.size();
-        const int current = letters * progress;
-        if (current == fromString.size()) {
-            return QString();
-        } else if (current < fromString.size()) {
-            fromString.chop(current);
-            return fromString;
+        d.revealLength = current - fromSize;
+        d.revealStart = toSize - d.revealLength;
+        return to;
+    }
+protected:
+    virtual void updateCurrentValue(const QVariant &value)
+    {
+        QPropertyAnimation::updateCurrentValue(value);
+        if (Item *item = targetItem())
+            item->setRevealRange(d.revealStart, d.revealLength);
+    }
+
+    virtual void updateState(QAbstractAnimation::State newState, QAbstractAnimation::State oldState)
+    {
+        QPropertyAnimation::updateState(newState, oldState);
+        if (newState == QAbstractAnimation::Stopped) {
+            if (Item *item = targetItem())
+                item->clearRevealRange();
         }
-        return toString.mid(toString.size() - (current - fromString.size()));
-#endif
     }
 private:
-    QGraphicsWidget *widget;
+    Item *targetItem() const
+    {
+        if (Proxy *proxy = qobject_cast<Proxy*>(targetObject()))
+            return proxy->activeFrame();
+        return qobject_cast<Item*>(targetObject());
+    }
+
+    mutable struct Data {
+        int revealStart, revealLength;
+    } d;
 };
 
 
@@ -68,11 +105,14 @@ private:
 GraphicsScene::GraphicsScene(QObject *parent)
     : QGraphicsScene(parent)
 {
-    qRegisterMetaType<StateType>("StateType");
     d.elapsed = 0;
-    d.currentState = 0;
+    d.currentState = NumStates;
     d.cancelTeam = 0;
     connect(&d.timeoutTimer, SIGNAL(timeout()), this, SLOT(nextStateTimeOut()));
+    connect(&d.model, SIGNAL(stateChanged(StateType)), this, SLOT(onModelStateChanged(StateType)));
+    connect(&d.model, SIGNAL(frameStatusChanged(int, GameModel::FrameStatus)),
+            this, SLOT(onFrameStatusChanged(int, GameModel::FrameStatus)));
+    connect(&d.model, SIGNAL(pointsChanged(int, int)), this, SLOT(onPointsChanged(int, int)));
 
     d.wrongAnswerItem = new Item;
     d.wrongAnswerItem->setOpacity(0.0);
@@ -98,86 +138,95 @@ GraphicsScene::GraphicsScene(QObject *parent)
     d.answerTime = 0;
     d.sceneRectChangedBlocked = false;
 
-    d.framesLeft = 0;
     d.currentFrame = 0;
 
-    const char *states[] = {
-        "Normal", "ShowQuestion", "TimeOut", "PickTeam",
-        "TeamTimedOut", "PickRightOrWrong", "WrongAnswer",
-        "RightAnswer", "NoAnswers", "Finished", 0
-    };
-    for (int i=0; states[i]; ++i) {
+    const QStringList args = QCoreApplication::arguments();
+    d.zoomTransform = args.contains("--zoom-transform");
+    d.frameGeometryProperty = d.zoomTransform ? "visualGeometry" : "geometry";
+    d.zoomPaints = 0;
+    d.zoomPaintTime = 0;
+    d.prewarmTime = 0;
+    connect(&d.prewarmWatcher, SIGNAL(finished()), this, SLOT(onPrewarmFinished()));
+    d.layoutAssigned = false;
+    d.relayoutTimer.setSingleShot(true);
+    d.relayoutTimer.setInterval(16);
+    connect(&d.relayoutTimer, SIGNAL(timeout()), this, SLOT(relayout()));
+    d.retryTimer.setSingleShot(true);
+    d.retryTimer.setInterval(50);
+    connect(&d.retryTimer, SIGNAL(timeout()), this, SLOT(retryClick()));
+
+    // --state-engine=qt goes through QStateMachine like it used to
+    d.stateEngine = !args.contains("--state-engine=qt");
+    if (d.stateEngine) {
+        connect(this, SIGNAL(next(int)), &d.engine, SLOT(next(int)));
+        connect(&d.engine, SIGNAL(entered(StateType)), this, SLOT(onStateEntered(StateType)));
+        connect(&d.engine, SIGNAL(exited(StateType)), this, SLOT(onStateExited(StateType)));
+    }
+    for (int i=0; i<NumStates; ++i) {
+        d.states[i] = 0;
+        if (d.stateEngine)
+            continue;
         State *state = new State(static_cast<StateType>(i), &d.stateMachine);
         connect(state, SIGNAL(entered()), this, SLOT(onStateEntered()));
         connect(state, SIGNAL(exited()), this, SLOT(onStateExited()));
-        state->setObjectName(states[i]);
+        state->setObjectName(GameModel::stateName(state->type()));
         d.states[i] = state;
     }
 
-    addTransition(Normal, ShowQuestion);
-    addTransition(ShowQuestion, TimeOut);
-    addTransition(ShowQuestion, PickTeam);
-    addTransition(TimeOut, Normal);
-    addTransition(TimeOut, Finished);
-    addTransition(PickTeam, NoAnswers);
-    addTransition(NoAnswers, Normal);
-    addTransition(NoAnswers, Finished);
-    addTransition(PickTeam, PickRightOrWrong);
-    addTransition(TeamTimedOut, ShowQuestion);
-    addTransition(PickRightOrWrong, RightAnswer);
-    addTransition(PickRightOrWrong, WrongAnswer);
-    addTransition(RightAnswer, Normal);
-    addTransition(RightAnswer, Finished);
-    addTransition(WrongAnswer, ShowQuestion);
-    addTransition(WrongAnswer, Normal);
-    addTransition(WrongAnswer, Finished);
-
-    d.states[Normal]->assignProperty(&d.proxy, "yRotation", 0.0);
-
-    d.states[ShowQuestion]->assignProperty(&d.proxy, "yRotation", 360.0);
-    d.states[ShowQuestion]->assignProperty(&d.proxy, "backgroundColor", Qt::yellow);
-    d.states[ShowQuestion]->assignProperty(&d.proxy, "color", Qt::black);
-
-    d.states[PickTeam]->assignProperty(d.teamProxy, "orientation", Qt::Vertical);
-
-    d.states[PickRightOrWrong]->assignProperty(d.teamProxy, "orientation", Qt::Horizontal);
-    d.states[PickRightOrWrong]->assignProperty(d.rightAnswerItem, "opacity", 1.0);
-    d.states[PickRightOrWrong]->assignProperty(d.wrongAnswerItem, "opacity", 1.0);
-    d.states[PickRightOrWrong]->assignProperty(d.teamProxy, "color", Qt::black);
-
-    d.states[WrongAnswer]->assignProperty(&d.proxy, "yRotation", 0.0);
-    d.states[WrongAnswer]->assignProperty(d.rightAnswerItem, "opacity", 0.0);
-    d.states[WrongAnswer]->assignProperty(d.wrongAnswerItem, "opacity", 0.0);
-    d.states[WrongAnswer]->assignProperty(d.teamProxy, "backgroundColor", Qt::red);
-    d.states[WrongAnswer]->assignProperty(d.teamProxy, "color", Qt::white);
-    d.states[WrongAnswer]->assignProperty(&d.proxy, "color", Qt::red);
-    d.states[WrongAnswer]->assignProperty(&d.proxy, "backgroundColor", Qt::black);
-
-    d.states[RightAnswer]->assignProperty(&d.proxy, "color", Qt::green);
-    d.states[RightAnswer]->assignProperty(d.teamProxy, "backgroundColor", Qt::darkGray);
-    d.states[RightAnswer]->assignProperty(d.teamProxy, "color", Qt::white);
-    d.states[RightAnswer]->assignProperty(d.rightAnswerItem, "opacity", 0.0);
-    d.states[RightAnswer]->assignProperty(d.wrongAnswerItem, "opacity", 0.0);
-    d.states[RightAnswer]->assignProperty(&d.proxy, "color", Qt::green);
-    d.states[RightAnswer]->assignProperty(&d.proxy, "backgroundColor", Qt::black);
-
-    d.states[NoAnswers]->assignProperty(&d.proxy, "color", Qt::red);
-    d.states[NoAnswers]->assignProperty(&d.proxy, "backgroundColor", Qt::black);
-    d.states[NoAnswers]->assignProperty(d.teamProxy, "orientation", Qt::Horizontal);
-
-    d.states[TeamTimedOut]->assignProperty(d.teamProxy, "backgroundColor", Qt::red);
-    d.states[TeamTimedOut]->assignProperty(&d.proxy, "color", Qt::black);
-    d.states[TeamTimedOut]->assignProperty(&d.proxy, "color", Qt::red);
-    d.states[TeamTimedOut]->assignProperty(&d.proxy, "backgroundColor", Qt::black);
-
-    d.states[RightAnswer]->assignProperty(&d.proxy, "yRotation", 0.0);
+    // The same edges the model takes
+    for (int from=0; !d.stateEngine && from<NumStates; ++from) {
+        for (int to=0; to<NumStates; ++to) {
+            if (GameModel::isTransition(static_cast<StateType>(from), static_cast<StateType>(to)))
+                addTransition(static_cast<StateType>(from), static_cast<StateType>(to));
+        }
+    }
+
+    assignProperty(Normal, &d.proxy, "yRotation", 0.0);
+
+    assignProperty(ShowQuestion, &d.proxy, "yRotation", 360.0);
+    assignProperty(ShowQuestion, &d.proxy, "backgroundColor", Qt::yellow);
+    assignProperty(ShowQuestion, &d.proxy, "color", Qt::black);
+
+    assignProperty(PickTeam, d.teamProxy, "orientation", Qt::Vertical);
+
+    assignProperty(PickRightOrWrong, d.teamProxy, "orientation", Qt::Horizontal);
+    assignProperty(PickRightOrWrong, d.rightAnswerItem, "opacity", 1.0);
+    assignProperty(PickRightOrWrong, d.wrongAnswerItem, "opacity", 1.0);
+    assignProperty(PickRightOrWrong, d.teamProxy, "color", Qt::black);
+
+    assignProperty(WrongAnswer, &d.proxy, "yRotation", 0.0);
+    assignProperty(WrongAnswer, d.rightAnswerItem, "opacity", 0.0);
+    assignProperty(WrongAnswer, d.wrongAnswerItem, "opacity", 0.0);
+    assignProperty(WrongAnswer, d.teamProxy, "backgroundColor", Qt::red);
+    assignProperty(WrongAnswer, d.teamProxy, "color", Qt::white);
+    assignProperty(WrongAnswer, &d.proxy, "color", Qt::red);
+    assignProperty(WrongAnswer, &d.proxy, "backgroundColor", Qt::black);
+
+    assignProperty(RightAnswer, &d.proxy, "color", Qt::green);
+    assignProperty(RightAnswer, d.teamProxy, "backgroundColor", Qt::darkGray);
+    assignProperty(RightAnswer, d.teamProxy, "color", Qt::white);
+    assignProperty(RightAnswer, d.rightAnswerItem, "opacity", 0.0);
+    assignProperty(RightAnswer, d.wrongAnswerItem, "opacity", 0.0);
+    assignProperty(RightAnswer, &d.proxy, "color", Qt::green);
+    assignProperty(RightAnswer, &d.proxy, "backgroundColor", Qt::black);
+
+    assignProperty(NoAnswers, &d.proxy, "color", Qt::red);
+    assignProperty(NoAnswers, &d.proxy, "backgroundColor", Qt::black);
+    assignProperty(NoAnswers, d.teamProxy, "orientation", Qt::Horizontal);
+
+    assignProperty(TeamTimedOut, d.teamProxy, "backgroundColor", Qt::red);
+    assignProperty(TeamTimedOut, &d.proxy, "color", Qt::black);
+    assignProperty(TeamTimedOut, &d.proxy, "color", Qt::red);
+    assignProperty(TeamTimedOut, &d.proxy, "backgroundColor", Qt::black);
+
+    assignProperty(RightAnswer, &d.proxy, "yRotation", 0.0);
 
     {
         QSequentialAnimationGroup *sequential = new QSequentialAnimationGroup(&d.stateMachine);
         QParallelAnimationGroup *parallel = new QParallelAnimationGroup;
         QPropertyAnimation *animation;
         enum { Duration = 1000 };
-        parallel->addAnimation(animation = new QPropertyAnimation(&d.proxy, "geometry"));
+        parallel->addAnimation(animation = new QPropertyAnimation(&d.proxy, d.frameGeometryProperty));
         animation->setDuration(Duration);
         parallel->addAnimation(animation = new QPropertyAnimation(&d.proxy, "yRotation"));
         animation->setDuration(Duration);
@@ -188,7 +237,7 @@ GraphicsScene::GraphicsScene(QObject *parent)
 
         QSequentialAnimationGroup *sequentialReverse = new QSequentialAnimationGroup(&d.stateMachine);
         parallel = new QParallelAnimationGroup;
-        parallel->addAnimation(animation = new QPropertyAnimation(&d.proxy, "geometry"));
+        parallel->addAnimation(animation = new QPropertyAnimation(&d.proxy, d.frameGeometryProperty));
         animation->setDuration(Duration);
         parallel->addAnimation(animation = new QPropertyAnimation(&d.proxy, "yRotation"));
         animation->setDuration(Duration);
@@ -196,11 +245,20 @@ GraphicsScene::GraphicsScene(QObject *parent)
         sequentialReverse->addAnimation(parallel);
         animation->setDuration(Duration);
 
-        transition(Normal, ShowQuestion)->addAnimation(sequential);
-        transition(NoAnswers, Normal)->addAnimation(sequentialReverse);
-        transition(RightAnswer, Normal)->addAnimation(sequentialReverse);
-        transition(WrongAnswer, Normal)->addAnimation(sequentialReverse);
-        transition(TimeOut, Normal)->addAnimation(sequentialReverse);
+        addAnimation(Normal, ShowQuestion, sequential);
+        addAnimation(NoAnswers, Normal, sequentialReverse);
+        addAnimation(RightAnswer, Normal, sequentialReverse);
+        addAnimation(WrongAnswer, Normal, sequentialReverse);
+        addAnimation(TimeOut, Normal, sequentialReverse);
+
+        if (d.zoomTransform)
+            connect(sequentialReverse, SIGNAL(finished()), this, SLOT(onFrameLowered()));
+        if (args.contains("--frame-times")) {
+            connect(sequential, SIGNAL(stateChanged(QAbstractAnimation::State, QAbstractAnimation::State)),
+                    this, SLOT(onZoomStateChanged(QAbstractAnimation::State)));
+            connect(sequentialReverse, SIGNAL(stateChanged(QAbstractAnimation::State, QAbstractAnimation::State)),
+                    this, SLOT(onZoomStateChanged(QAbstractAnimation::State)));
+        }
 
     }
 
@@ -228,10 +286,10 @@ GraphicsScene::GraphicsScene(QObject *parent)
             animation->setDuration(Duration);
         }
 
-        transition(TimeOut, Finished)->addAnimation(sequential);
-        transition(WrongAnswer, Finished)->addAnimation(sequential);
-        transition(RightAnswer, Finished)->addAnimation(sequential);
-        transition(NoAnswers, Finished)->addAnimation(sequential);
+        addAnimation(TimeOut, Finished, sequential);
+        addAnimation(WrongAnswer, Finished, sequential);
+        addAnimation(RightAnswer, Finished, sequential);
+        addAnimation(NoAnswers, Finished, sequential);
     }
 
     {
@@ -240,14 +298,41 @@ GraphicsScene::GraphicsScene(QObject *parent)
         enum { Duration = 1000 };
         teamAnimation->addAnimation(animation = new QPropertyAnimation(d.teamProxy, "geometry"));
         animation->setDuration(Duration);
-        transition(ShowQuestion, PickTeam)->addAnimation(teamAnimation);
-        transition(PickTeam, NoAnswers)->addAnimation(teamAnimation);
-        transition(PickTeam, PickRightOrWrong)->addAnimation(teamAnimation);
+        addAnimation(ShowQuestion, PickTeam, teamAnimation);
+        addAnimation(PickTeam, NoAnswers, teamAnimation);
+        addAnimation(PickTeam, PickRightOrWrong, teamAnimation);
     }
 
 
-    d.stateMachine.setInitialState(d.states[Normal]);
-    d.stateMachine.start();
+    startStates();
+}
+
+void GraphicsScene::startStates()
+{
+    if (d.stateEngine) {
+        d.engine.setState(Normal);
+    } else if (!d.stateMachine.isRunning()) {
+        d.stateMachine.setInitialState(d.states[Normal]);
+        d.stateMachine.start();
+    }
+}
+
+void GraphicsScene::assignProperty(StateType state, QObject *object, const char *name, const QVariant &value)
+{
+    if (d.stateEngine) {
+        d.engine.assignProperty(state, object, name, value);
+    } else {
+        d.states[state]->assignProperty(object, name, value);
+    }
+}
+
+void GraphicsScene::addAnimation(StateType from, StateType to, QAbstractAnimation *animation)
+{
+    if (d.stateEngine) {
+        d.engine.addAnimation(from, to, animation);
+    } else {
+        transition(from, to)->addAnimation(animation);
+    }
 }
 
 static QStringList pickTeams(QWidget *parent)
@@ -284,6 +369,7 @@ static QStringList pickTeams(QWidget *parent)
 
 void GraphicsScene::init(const QStringList &categories, const QList<QPair<QString, QString> > &frames)
 {
+    static const bool cardFlip = QCoreApplication::arguments().contains("--card-flip");
     const int count = categories.size();
     Q_ASSERT(count * 5 == frames.size());
     for (int i=0; i<count; ++i) {
@@ -297,6 +383,7 @@ void GraphicsScene::init(const QStringList &categories, const QList<QPair<QStrin
         for (int j=0; j<5; ++j) {
             Frame *frame = new Frame(j, i);
             connect(frame, SIGNAL(clicked(Item*, QPointF)), this, SLOT(onClicked(Item*)));
+            connect(frame, SIGNAL(hovered(Item*)), this, SLOT(onFrameHovered(Item*)));
             frame->setFlag(QGraphicsItem::ItemIsSelectable, true);
             frame->setBackgroundColor(Qt::blue);
             frame->setColor(Qt::white);
@@ -305,6 +392,7 @@ void GraphicsScene::init(const QStringList &categories, const QList<QPair<QStrin
             frame->setQuestion(data.first);
             frame->setAnswer(data.second);
             frame->setText(frame->valueString());
+            frame->setCardMode(cardFlip);
 
             addItem(frame);
             d.frames.append(frame);
@@ -313,65 +401,31 @@ void GraphicsScene::init(const QStringList &categories, const QList<QPair<QStrin
 }
 
 
-bool GraphicsScene::load(QIODevice *device, const QStringList &tms)
+bool GraphicsScene::load(QIODevice *device, const QStringList &teams)
+{
+    GameData game;
+    QString error;
+    if (!GameLoader::load(device, &game, &error)) {
+        qWarning("%s", qPrintable(error));
+        reset();
+        return false;
+    }
+    return setGame(game, teams);
+}
+
+bool GraphicsScene::setGame(const GameData &game, const QStringList &tms)
 {
     reset();
     disconnect(this, SIGNAL(sceneRectChanged(QRectF)), this, SLOT(onSceneRectChanged(QRectF)));
 
-    switch (loadJavaScriptGame(device)) {
-    case Failure:
-        return false;
-    case Success:
-        break;
-    case NotJavascript: {
-        device->seek(0);
-        QTextStream ts(device);
-        enum State {
-            ExpectingTopic,
-            ExpectingQuestion
-        } state = ExpectingTopic;
-
-//    TopicItem *topic = 0;
-        int lineNumber = 0;
-        QRegExp commentRegexp("^ *#");
-        QStringList categories;
-        QList<QPair<QString, QString> > frames;
-
-        while (!ts.atEnd()) {
-            ++lineNumber;
-            const QString line = ts.readLine().simplified();
-            if (line.indexOf(commentRegexp) == 0)
-                continue;
-            switch (state) {
-            case ExpectingTopic:
-                if (line.isEmpty())
-                    continue;
-                categories.append(line);
-                state = ExpectingQuestion;
-                break;
-            case ExpectingQuestion:
-                if (line.isEmpty()) {
-                    qWarning() << "Didn't expect an empty line here. I was looking question number"
-                               << (d.frames.size() % 5) << "for" << d.topics.last()->text() << "on line" << lineNumber;
-                    reset();
-                    return false;
-                } else {
-                    const QStringList split = line.split('|');
-                    if (split.size() != 2) {
-                        qWarning("I don't understand this line. There can only be one | per question line (%s) line: %d",
-                                 qPrintable(line), lineNumber);
-                        reset();
-                        return false;
-                    }
-                    frames.append(qMakePair(split.at(0), split.at(1)));
-                    if (frames.size() % 5 == 0)
-                        state = ExpectingTopic;
-                }
-                break;
-            }
+    d.gameStorage = game.storage;
+    init(game.categories, game.frames);
+    d.generator = game.generator;
+    if (d.generator) {
+        for (int i=0; i<game.frames.size(); ++i) {
+            if (game.frames.at(i).first.isNull())
+                d.ungeneratedFrames.insert(d.frames.at(i));
         }
-        init(categories, frames);
-        break; }
     }
 
     const QStringList teams = (tms.isEmpty() ? pickTeams(views().value(0)) : tms);
@@ -388,18 +442,18 @@ bool GraphicsScene::load(QIODevice *device, const QStringList &tms)
 //        d.states[WrongAnswer]->assignProperty(team, "backgroundColor", Qt::darkGray);
 //         d.states[RightAnswer]->assignProperty(team, "backgroundColor", Qt::darkGray);
 //         d.states[RightAnswer]->assignProperty(team, "color", Qt::white);
-        d.states[Normal]->assignProperty(team, "backgroundColor", Qt::darkGray);
-        d.states[Normal]->assignProperty(team, "color", Qt::white);
-        d.states[Finished]->assignProperty(team, "yRotation", 720.0);
+        assignProperty(Normal, team, "backgroundColor", Qt::darkGray);
+        assignProperty(Normal, team, "color", Qt::white);
+        assignProperty(Finished, team, "yRotation", 720.0);
         d.teams.append(team);
         addItem(team);
     }
 
     d.cancelTeam = new Team(tr("Cancel"));
     connect(d.cancelTeam, SIGNAL(clicked(Item*, QPointF)), this, SLOT(onClicked(Item*)));
-    d.states[NoAnswers]->assignProperty(d.cancelTeam, "visible", false);
-    d.states[PickTeam]->assignProperty(d.cancelTeam, "visible", true);
-    d.states[PickRightOrWrong]->assignProperty(d.cancelTeam, "visible", false);
+    assignProperty(NoAnswers, d.cancelTeam, "visible", false);
+    assignProperty(PickTeam, d.cancelTeam, "visible", true);
+    assignProperty(PickRightOrWrong, d.cancelTeam, "visible", false);
 
     d.cancelTeam->setZValue(100.0);
     d.cancelTeam->setBackgroundColor(Qt::black);
@@ -410,31 +464,112 @@ bool GraphicsScene::load(QIODevice *device, const QStringList &tms)
     addItem(d.cancelTeam);
     d.teamProxy->setTeams(d.teams);
 
+    // Start over from Normal, a finished game stopped the state machine
+    if (d.stateEngine || d.currentState == Finished)
+        startStates();
+
+    d.model.setGame(game.categories, game.frames, teams);
+
     onSceneRectChanged(sceneRect());
     connect(this, SIGNAL(sceneRectChanged(QRectF)), this, SLOT(onSceneRectChanged(QRectF)));
-
-    d.framesLeft = d.frames.size();
     return true;
 }
 
+enum { TeamsHeight = 100 };
+
+static inline QRectF teamsGeometry(const QRectF &sceneRect)
+{
+    return QRectF(sceneRect.topLeft(), QSize(sceneRect.width(), TeamsHeight));
+}
+
+static inline QRectF framesGeometry(const QRectF &sceneRect)
+{
+    return sceneRect.adjusted(0, TeamsHeight, 0, 0);
+}
+
+// Where a frame sits on the board, below the row of topics
+static inline QRectF frameGeometry(int row, int column, int columns, const QRectF &framesGeometry)
+{
+    enum { Rows = 5 };
+    return ::itemGeometry(row + 1, column, Rows + 1, columns, framesGeometry);
+}
+
 void GraphicsScene::onSceneRectChanged(const QRectF &rr)
 {
     if (d.sceneRectChangedBlocked || rr.isEmpty())
         return;
 
-    enum { TeamsHeight = 100 };
-    d.teamsGeometry = QRectF(rr.topLeft(), QSize(rr.width(), TeamsHeight));
-    d.framesGeometry = rr.adjusted(0, TeamsHeight, 0, 0 );
+    // Resize events come in storms. Lay out at most once per frame
+    d.relayoutRect = rr;
+    if (!d.relayoutTimer.isActive())
+        d.relayoutTimer.start();
+}
 
-    d.states[ShowQuestion]->assignProperty(&d.proxy, "geometry", ::raisedGeometry(d.framesGeometry));
+void GraphicsScene::relayout()
+{
+    if (!d.relayoutRect.isEmpty())
+        prewarm(d.relayoutRect);
+}
 
-    d.sceneRectChangedBlocked = true;
+// Renders the faces the items will need at their new geometry on the
+// thread pool. The current layout stays on screen until all of them are
+// in the face atlas and the new one is applied in one go.
+void GraphicsScene::prewarm(const QRectF &rect)
+{
+    d.prewarmWatcher.cancel();
+    d.prewarmRequests.clear();
+
+    QSet<FaceAtlas::Key> keys;
+    const ItemGeometries geometries = itemGeometries(rect);
+    for (int i=0; i<geometries.size(); ++i) {
+        const Item *item = geometries.at(i).first;
+        const QSize size = geometries.at(i).second.toRect().size();
+        for (int hovered=0; hovered<2; ++hovered) {
+            if (hovered && !item->acceptsHoverEvents())
+                break;
+            const FaceRequest request = item->faceRequest(size, hovered);
+            if (!keys.contains(request.key) && !d.faceAtlas.contains(request.key)) {
+                keys.insert(request.key);
+                d.prewarmRequests.append(request);
+            }
+        }
+    }
+
+    if (d.prewarmRequests.isEmpty() || !QFontDatabase::supportsThreadedFontRendering()) {
+        d.prewarmRequests.clear();
+        applyLayout(rect);
+        return;
+    }
+    d.prewarmRect = rect;
+    d.prewarmTimer.start();
+    d.prewarmWatcher.setFuture(QtConcurrent::mapped(d.prewarmRequests, Item::renderFaceImage));
+}
+
+void GraphicsScene::onPrewarmFinished()
+{
+    if (d.prewarmWatcher.isCanceled())
+        return;
+    const QList<QImage> images = d.prewarmWatcher.future().results();
+    Q_ASSERT(images.size() == d.prewarmRequests.size());
+    for (int i=0; i<images.size(); ++i) {
+        d.faceAtlas.insert(d.prewarmRequests.at(i).key, QPixmap::fromImage(images.at(i)));
+    }
+    d.prewarmTime = d.prewarmTimer.elapsed();
+    if (RenderStats::isEnabled())
+        qDebug("Pre-warmed %d faces in %d ms", images.size(), d.prewarmTime);
+    d.prewarmRequests.clear();
+    applyLayout(d.prewarmRect);
+}
+
+ItemGeometries GraphicsScene::itemGeometries(const QRectF &rr) const
+{
+    ItemGeometries geometries;
+    const QRectF framesGeometry = ::framesGeometry(rr);
+    const QRectF raised = ::raisedGeometry(framesGeometry);
     const int cols = d.topics.size();
     static const int rows = 5;
     for (int i=0; i<cols; ++i)
-        d.topics.at(i)->setGeometry(::itemGeometry(0, i, rows, cols, d.framesGeometry));
-
-    const QRectF raised = ::raisedGeometry(d.framesGeometry);
+        geometries.append(qMakePair(d.topics.at(i), ::itemGeometry(0, i, rows, cols, framesGeometry)));
 
     for (int i=0; i<rows * cols; ++i) {
         Frame *frame = d.frames.at(i);
@@ -442,31 +577,69 @@ void GraphicsScene::onSceneRectChanged(const QRectF &rr)
         if (frame == d.proxy.activeFrame()) {
             r = raised;
         } else {
-            const int y = i % rows;
-            const int x = i / rows;
-            r = ::itemGeometry(y + 1, x, rows + 1, cols, d.framesGeometry);
+            r = ::frameGeometry(i % rows, i / rows, cols, framesGeometry);
         }
-        frame->setGeometry(r);
+        geometries.append(qMakePair<Item*, QRectF>(frame, r));
+    }
+
+    if (!d.teams.isEmpty())
+        geometries += teamGeometries(::teamsGeometry(rr), Qt::Horizontal);
+    geometries.append(qMakePair(d.wrongAnswerItem, ::itemGeometry(0, 0, 1, 2, raised)));
+    geometries.append(qMakePair(d.rightAnswerItem, ::itemGeometry(0, 1, 1, 2, raised)));
+    return geometries;
+}
+
+void GraphicsScene::applyLayout(const QRectF &rr)
+{
+    const QRectF oldRaised = ::raisedGeometry(d.framesGeometry);
+    const QRectF oldTeamsGeometry = d.teamsGeometry;
+    d.teamsGeometry = ::teamsGeometry(rr);
+    d.framesGeometry = ::framesGeometry(rr);
+    const QRectF raised = ::raisedGeometry(d.framesGeometry);
+
+    d.sceneRectChangedBlocked = true;
+    const ItemGeometries geometries = itemGeometries(rr);
+    for (int i=0; i<geometries.size(); ++i) {
+        Item *item = geometries.at(i).first;
+        if (item->geometry() != geometries.at(i).second)
+            item->setGeometry(geometries.at(i).second);
     }
 
-    setTeamGeometry(d.teamsGeometry, Qt::Horizontal);
 //     static QState *const states[] = {
 //         d.states[Normal], d.states[ShowQuestion], d.states[ShowAnswer],
 //         d.states[PickRightOrWrong], d.states[RightAnswer], d.states[WrongAnswer], 0
 //     };
 
-    for (int i=0; i<NumStates; ++i) {
-        d.states[i]->assignProperty(d.teamProxy, "geometry", i == PickTeam ? raised : d.teamsGeometry);
+    if (raised != oldRaised || d.teamsGeometry != oldTeamsGeometry || !d.layoutAssigned) {
+        assignProperty(ShowQuestion, &d.proxy, d.frameGeometryProperty.constData(), raised);
+        for (int i=0; i<NumStates; ++i) {
+            assignProperty(static_cast<StateType>(i), d.teamProxy, "geometry", i == PickTeam ? raised : d.teamsGeometry);
+        }
+        d.layoutAssigned = true;
     }
-    d.wrongAnswerItem->setGeometry(QRectF(raised.x(), raised.y(), raised.width() / 2, raised.height()));
-    d.rightAnswerItem->setGeometry(QRectF(raised.x() + (raised.width() / 2), raised.y(), raised.width() / 2, raised.height()));
 
     d.sceneRectChangedBlocked = false;
+    emit layoutApplied();
+}
+
+GraphicsScene::~GraphicsScene()
+{
+    d.prewarmWatcher.cancel();
+    // Running jobs render text that may point into d.gameStorage
+    d.prewarmWatcher.waitForFinished();
+    // The items can hold strings that point into d.gameStorage
+    clear();
 }
 
 void GraphicsScene::reset()
 {
+    d.prewarmWatcher.cancel();
+    // Running jobs render text that may point into d.gameStorage
+    d.prewarmWatcher.waitForFinished();
+    d.prewarmRequests.clear();
     d.teamProxy->setActiveTeam(0);
+    d.teamProxy->setTeams(QList<Team*>());
+    d.proxy.setActiveFrame(static_cast<Frame*>(0));
     Q_ASSERT(d.rightAnswerItem);
     Q_ASSERT(d.wrongAnswerItem);
     removeItem(d.rightAnswerItem);
@@ -474,12 +647,73 @@ void GraphicsScene::reset()
     d.sceneRectChangedBlocked = false;
     clear();
     d.frames.clear();
+    d.ungeneratedFrames.clear();
+    d.prefetchedFrames.clear();
+    d.retryFrame = 0;
+    d.retryTimer.stop();
+    d.generator.clear();
+    d.model.clear();
+    d.currentFrame = 0;
     d.topics.clear();
     d.teams.clear();
     addItem(d.rightAnswerItem);
     addItem(d.wrongAnswerItem);
 }
 
+void GraphicsScene::generateQuestion(Frame *frame)
+{
+    QString question, answer, error;
+    if (!d.generator->generate(frame->column(), frame->row(), &question, &answer, &error)) {
+        qWarning("Can't generate question %d for %s: %s", frame->row() + 1,
+                 qPrintable(d.topics.at(frame->column())->text()), qPrintable(error));
+        question = answer = tr("?");
+    }
+    frame->setQuestion(question);
+    frame->setAnswer(answer);
+    d.model.setQuestion(d.frames.indexOf(frame), question, answer);
+}
+
+// A hovered frame is likely to be clicked, its question is generated in
+// the background meanwhile. Frames that are never hovered cost nothing.
+void GraphicsScene::onFrameHovered(Item *item)
+{
+    Frame *frame = static_cast<Frame*>(item);
+    if (d.ungeneratedFrames.contains(frame) && !d.prefetchedFrames.contains(frame)) {
+        d.prefetchedFrames.insert(frame);
+        d.generator->prefetch(frame->column(), frame->row());
+    }
+}
+
+void GraphicsScene::retryClick()
+{
+    if (Frame *frame = d.retryFrame) {
+        d.retryFrame = 0;
+        onClicked(frame);
+    }
+}
+
+QStringList GraphicsScene::teamNames() const
+{
+    QStringList names;
+    foreach(const Team *team, d.teams) {
+        if (team != d.cancelTeam)
+            names.append(team->objectName());
+    }
+    return names;
+}
+
+// Items ask on every paint. The transition animations are groups owned by
+// the state machine, a group runs when any of its animations do.
+bool GraphicsScene::isAnimating() const
+{
+    foreach(const QObject *child, d.stateMachine.children()) {
+        const QAbstractAnimation *animation = qobject_cast<const QAbstractAnimation*>(child);
+        if (animation && animation->state() != QAbstractAnimation::Stopped)
+            return true;
+    }
+    return false;
+}
+
 void GraphicsScene::mousePressEvent(QGraphicsSceneMouseEvent *e)
 {
     emit mouseButtonPressed(e->scenePos(), e->button());
@@ -489,13 +723,13 @@ void GraphicsScene::mousePressEvent(QGraphicsSceneMouseEvent *e)
 
 QRectF GraphicsScene::frameGeometry(Frame *frame) const
 {
-    return ::itemGeometry(frame->row() + 1, frame->column(), 6, d.topics.size(), d.framesGeometry);
+    return ::frameGeometry(frame->row(), frame->column(), d.topics.size(), d.framesGeometry);
 }
 
 void GraphicsScene::onClicked(Item *item)
 {
-    if (d.currentState && item) {
-        const StateType type = d.currentState->type();
+    if (d.currentState != NumStates && item) {
+        const StateType type = d.model.state();
         switch (type) {
         case NoAnswers:
             break;
@@ -503,6 +737,17 @@ void GraphicsScene::onClicked(Item *item)
             if (Frame *frame = qgraphicsitem_cast<Frame*>(item)) {
                 if (frame->status() != Frame::Hidden)
                     break;
+                if (d.ungeneratedFrames.contains(frame)) {
+                    if (d.prefetchedFrames.contains(frame) && !d.generator->isReady(frame->column(), frame->row())) {
+                        // On its way since the frame was hovered, don't
+                        // freeze the board waiting for it
+                        d.retryFrame = frame;
+                        d.retryTimer.start();
+                        break;
+                    }
+                    d.ungeneratedFrames.remove(frame);
+                    generateQuestion(frame);
+                }
                 foreach(Frame *f, d.frames) {
                     if (f != frame && f->status() == Frame::Hidden) {
                         f->setAcceptHoverEvents(false);
@@ -511,19 +756,27 @@ void GraphicsScene::onClicked(Item *item)
 
                 d.currentFrame = frame;
                 d.proxy.setActiveFrame(frame);
+                if (frame->cardMode())
+                    frame->prepareCard(frame->question(), ::raisedGeometry(d.framesGeometry).size().toSize());
                 const QRectF r = frameGeometry(frame);
-                d.states[Normal]->assignProperty(&d.proxy, "geometry", r);
-                d.states[ShowQuestion]->assignProperty(&d.proxy, "text", frame->question());
-                d.states[RightAnswer]->assignProperty(&d.proxy, "text", QString("%1 is the answer :-)").arg(frame->answer()));
-                d.states[WrongAnswer]->assignProperty(&d.proxy, "text", QString("%1 is the answer :-(").arg(frame->answer()));
-                emit next(ShowQuestion);
+                if (d.zoomTransform) {
+                    // Lay the frame out at its raised size once and zoom it
+                    // out of its cell with the transform
+                    frame->setGeometry(::raisedGeometry(d.framesGeometry));
+                    frame->setVisualGeometry(r);
+                }
+                assignProperty(Normal, &d.proxy, d.frameGeometryProperty.constData(), r);
+                assignProperty(ShowQuestion, &d.proxy, "text", frame->question());
+                assignProperty(RightAnswer, &d.proxy, "text", QString("%1 is the answer :-)").arg(frame->answer()));
+                assignProperty(WrongAnswer, &d.proxy, "text", QString("%1 is the answer :-(").arg(frame->answer()));
+                d.model.pickFrame(d.frames.indexOf(frame));
             }
             break;
         case ShowQuestion:
             if (item == d.currentFrame) {
                 d.elapsed += d.timeoutTimerStarted.msecsTo(QTime::currentTime());
                 d.timeoutTimer.stop();
-                emit next(PickTeam);
+                d.model.stopClock();
             }
             break;
         case TimeOut:
@@ -531,10 +784,10 @@ void GraphicsScene::onClicked(Item *item)
         case PickTeam:
             if (Team *team = qgraphicsitem_cast<Team*>(item)) {
                 if (team == d.cancelTeam) {
-                    emit next(NoAnswers);
+                    d.model.noAnswers();
                 } else if (team->acceptsHoverEvents()) {
                     d.teamProxy->setActiveTeam(team);
-                    emit next(PickRightOrWrong);
+                    d.model.pickTeam(d.teams.indexOf(team));
                 }
             }
             break;
@@ -542,16 +795,16 @@ void GraphicsScene::onClicked(Item *item)
             break;
         case PickRightOrWrong:
             if (item == d.rightAnswerItem) {
-                emit next(RightAnswer);
+                d.model.answer(true);
             } else if (item == d.wrongAnswerItem) {
-                emit next(WrongAnswer);
+                d.model.answer(false);
             }
             break;
         case WrongAnswer:
             break;
         case RightAnswer:
             if (item == d.currentFrame) {
-                finishQuestion();
+                d.model.finishQuestion();
             }
             break;
         case Finished:
@@ -567,6 +820,33 @@ int GraphicsScene::answerTime() const
     return d.answerTime;
 }
 
+void GraphicsScene::onFrameLowered()
+{
+    if (Frame *frame = d.proxy.activeFrame()) {
+        frame->setGeometry(frameGeometry(frame));
+        frame->setVisualGeometry(QRectF());
+    }
+}
+
+void GraphicsScene::onZoomStateChanged(QAbstractAnimation::State state)
+{
+    Frame *frame = d.proxy.activeFrame();
+    if (!frame || !RenderStats::isEnabled())
+        return;
+    if (state == QAbstractAnimation::Running) {
+        d.zoomTimer.start();
+        d.zoomPaints = frame->paintCount();
+        d.zoomPaintTime = frame->paintTime();
+    } else if (state == QAbstractAnimation::Stopped && d.zoomTimer.isValid()) {
+        const int paints = frame->paintCount() - d.zoomPaints;
+        const qint64 paintTime = frame->paintTime() - d.zoomPaintTime;
+        qDebug("%s zoom: %d paints of the active frame in %lld ms, %.3f ms per paint",
+               d.zoomTransform ? "transform" : "geometry", paints, d.zoomTimer.elapsed(),
+               paints ? double(paintTime) / 1000000.0 / paints : 0.0);
+        d.zoomTimer.invalidate();
+    }
+}
+
 void GraphicsScene::clearActiveFrame()
 {
     Q_ASSERT(d.proxy.activeFrame());
@@ -578,6 +858,13 @@ void GraphicsScene::clearActiveFrame()
 void GraphicsScene::setTeamGeometry(const QRectF &rect, Qt::Orientation orientation)
 {
     d.teamsGeometry = rect;
+    const ItemGeometries geometries = teamGeometries(rect, orientation);
+    for (int i=0; i<geometries.size(); ++i)
+        geometries.at(i).first->setGeometry(geometries.at(i).second);
+}
+
+ItemGeometries GraphicsScene::teamGeometries(const QRectF &rect, Qt::Orientation orientation) const
+{
     Q_ASSERT(!d.teams.isEmpty());
     int count = d.teams.size();
     for (int i=count - 1; i>=0; --i) {
@@ -595,12 +882,14 @@ void GraphicsScene::setTeamGeometry(const QRectF &rect, Qt::Orientation orientat
         r.setWidth((rect.width() / count) - Margin);
         add.rx() = r.width() + Margin;
     }
+    ItemGeometries geometries;
     for (int i=0; i<d.teams.size(); ++i) {
         if (d.teams.at(i)->isVisible()) {
-            d.teams.at(i)->setGeometry(r);
+            geometries.append(qMakePair<Item*, QRectF>(d.teams.at(i), r));
             r.translate(add);
         }
     }
+    return geometries;
 }
 
 static inline bool compareTeamsByScore(const Team *left, const Team *right)
@@ -610,101 +899,98 @@ static inline bool compareTeamsByScore(const Team *left, const Team *right)
 
 void GraphicsScene::onStateEntered()
 {
-    d.currentState = qobject_cast<State*>(sender());
-//    qDebug() << d.currentState->objectName() << "entered" << QTime::currentTime().toString("mm:ss");
-    const StateType type = d.currentState->type();
+    onStateEntered(qobject_cast<State*>(sender())->type());
+}
+
+void GraphicsScene::onStateExited()
+{
+    onStateExited(qobject_cast<State*>(sender())->type());
+}
+
+void GraphicsScene::onStateEntered(StateType type)
+{
+    d.currentState = type;
+//    qDebug() << GameModel::stateName(type) << "entered" << QTime::currentTime().toString("mm:ss");
+    if (type == Finished) {
+        if (!d.stateEngine)
+            d.stateMachine.stop();
+        emit gameFinished();
+    }
+}
+
+// The model has already moved on by the time the state machine enters a
+// state, so everything that needs the frame or team the model is looking
+// at is set up here, before the state machine is told.
+void GraphicsScene::onModelStateChanged(StateType type)
+{
     switch (type) {
     case Normal:
-        Q_ASSERT(d.teamsAttempted.isEmpty());
+    case Finished:
+        if (d.currentFrame) {
+            d.currentFrame->setAcceptHoverEvents(false);
+            d.currentFrame = 0;
+        }
+        if (type == Finished) {
+            setupFinishState();
+            break;
+        }
         d.teamProxy->setActiveTeam(0);
         Q_ASSERT(!d.teamProxy->activeTeam());
-        Q_ASSERT(!d.currentFrame);
         d.elapsed = 0;
         foreach(Frame *f, d.frames) {
             if (f->status() == Frame::Hidden) {
                 f->setAcceptHoverEvents(true);
             }
         }
-
         break;
-    case ShowQuestion: {
+    case ShowQuestion:
 //        d.timeoutTimer.start(5000 - d.elapsed);
-        if (d.teamsAttempted.size() == d.teams.size()) {
-            emit next(TimeOut);
-        } else {
-            Q_ASSERT(d.currentFrame);
-//                 qDebug() << "showing question" << d.currentFrame->question
-//                          << "worth" << d.currentFrame->value << "$";
-        }
-        break; }
-    case TimeOut:
         Q_ASSERT(d.currentFrame);
-        d.currentFrame->setStatus(Frame::Failed);
-        finishQuestion();
         break;
     case PickTeam:
         d.teamProxy->setActiveTeam(0);
-        foreach(Team *team, d.teams) {
-            if (!d.teamsAttempted.contains(team))
-                team->setAcceptHoverEvents(true);
+        for (int i=0; i<d.teams.size(); ++i) {
+            if (d.teams.at(i) == d.cancelTeam || !d.model.hasAttempted(i))
+                d.teams.at(i)->setAcceptHoverEvents(true);
         }
         Q_ASSERT(!d.teamProxy->activeTeam());
         break;
     case TeamTimedOut:
-        ++d.timedout;
     case WrongAnswer:
-        if (type == WrongAnswer)
-            ++d.wrong;
         Q_ASSERT(d.teamProxy->activeTeam());
         Q_ASSERT(d.currentFrame);
-        d.teamProxy->activeTeam()->addPoints(-d.currentFrame->value() / 2);
-        d.currentFrame->setStatus(Frame::Failed);
-        d.states[Normal]->assignProperty(&d.proxy, "text", d.currentFrame->answer());
-        if (d.teamsAttempted.size() + 2 == d.teams.size()) {
-            finishQuestion();
-        } else {
-            d.teamsAttempted.insert(d.teamProxy->activeTeam());
-            emit next(ShowQuestion);
-        }
+        assignProperty(Normal, &d.proxy, "text", d.currentFrame->answer());
         break;
     case NoAnswers:
-        ++d.wrong;
         Q_ASSERT(d.currentFrame);
         Q_ASSERT(!d.teamProxy->activeTeam());
-        d.states[Normal]->assignProperty(&d.proxy, "text", d.currentFrame->question());
-        d.currentFrame->setStatus(Frame::Failed);
-        finishQuestion();
+        assignProperty(Normal, &d.proxy, "text", d.currentFrame->question());
         break;
     case RightAnswer:
-        ++d.right;
         Q_ASSERT(d.teamProxy->activeTeam());
         Q_ASSERT(d.currentFrame);
-        d.states[Normal]->assignProperty(&d.proxy, "text", d.currentFrame->answer());
-        d.teamProxy->activeTeam()->addPoints(d.currentFrame->value());
-//             qDebug() << d.teamProxy->activeTeam()->name << "answered correctly and earned" << d.currentFrame->value
-//                      << "$. They now have" << d.teamProxy->activeTeam()->score << "$";
-        d.currentFrame->setStatus(Frame::Succeeded);
-        break;
-    case Finished:
-//         qSort(d.teams.end(), d.teams.begin(), compareTeamsByScore);
-//         for (int i=0; i<d.teams.size(); ++i) {
-//             qDebug() << i << d.teams.at(i)->points() << d.teams.at(i)->objectName();
-//         }
-//         qDebug() << "right" << d.right << "wrong" << d.wrong << "timedout" << d.timedout;
-        d.stateMachine.stop();
+        assignProperty(Normal, &d.proxy, "text", d.currentFrame->answer());
         break;
+    case TimeOut:
     case PickRightOrWrong:
-        break;
     case NumStates:
         break;
     }
-//        qDebug() << sender()->objectName() << "entered";
+    emit next(type);
 }
 
-void GraphicsScene::onStateExited()
+void GraphicsScene::onFrameStatusChanged(int frame, GameModel::FrameStatus status)
+{
+    d.frames.at(frame)->setStatus(static_cast<Frame::Status>(status));
+}
+
+void GraphicsScene::onPointsChanged(int team, int points)
+{
+    d.teams.at(team)->setPoints(points);
+}
+
+void GraphicsScene::onStateExited(StateType type)
 {
-    State *state = qobject_cast<State*>(sender());
-    const StateType type = state->type();
     switch (type) {
     case PickTeam:
         foreach(Team *team, d.teams)
@@ -731,19 +1017,6 @@ void GraphicsScene::onStateExited()
 }
 
 
-void GraphicsScene::finishQuestion()
-{
-    d.currentFrame->setAcceptHoverEvents(false);
-    d.currentFrame = 0;
-    d.teamsAttempted.clear();
-    if (!--d.framesLeft) {
-        setupFinishState();
-        emit next(Finished);
-    } else {
-        emit next(Normal);
-    }
-}
-
 Transition *GraphicsScene::transition(StateType from, StateType to) const
 {
     Q_ASSERT(from != to);
@@ -763,12 +1036,6 @@ Transition *GraphicsScene::addTransition(StateType from, StateType to)
     return transition;
 }
 
-void State::addTransition(StateType type, Transition *transition)
-{
-    d.transitions[type] = transition;
-    QState::addTransition(transition);
-}
-
 
 void GraphicsScene::setupFinishState()
 {
@@ -783,106 +1050,19 @@ void GraphicsScene::setupFinishState()
     const QRgb colors[] = { 0xcd7f32, 0xe6e8fa, 0x8c7853, 0xb87333 };
 
     for (int i=0; i<count; ++i) {
-        d.states[Finished]->assignProperty(teams.at(i), "geometry", rect);
+        assignProperty(Finished, teams.at(i), "geometry", rect);
         QString title;
         if (i < 3) {
             title = titles[i];
         } else {
             title = QString("%1.").arg(i + 1);
         }
-        d.states[Finished]->assignProperty(teams.at(i), "text", QString("%1 %2 %3").
-                                           arg(title, teams.at(i)->objectName(),
-                                               teams.at(i)->pointsString()));
+        assignProperty(Finished, teams.at(i), "text", QString("%1 %2 %3").
+                       arg(title, teams.at(i)->objectName(), teams.at(i)->pointsString()));
         const QColor color = colors[qMin(3, i)];
         const QColor reversed(255 - color.red(), 255 - color.green(), 255 - color.blue());
-        d.states[Finished]->assignProperty(teams.at(i), "backgroundColor", color);
-        d.states[Finished]->assignProperty(teams.at(i), "color", reversed);
+        assignProperty(Finished, teams.at(i), "backgroundColor", color);
+        assignProperty(Finished, teams.at(i), "color", reversed);
         rect.translate(0, rect.height());
     }
-//    qDebug() << "right" << d.right << "wrong" << d.wrong << "timedout" << d.timedout;
-}
-
-static inline QScriptValue random(QScriptContext *ctx, QScriptEngine *)
-{
-    switch (ctx->argumentCount()) {
-    case 1:
-        if (!ctx->argument(0).isNumber()) {
-            ctx->throwError("Invalid argument");
-            return QScriptValue();
-        }
-        return (rand() % ctx->argument(0).toInt32()) + 1;
-    default:
-        ctx->throwError("Invalid amount of arguments to rand(). Need 1 or 2");
-        return QScriptValue();
-    case 2:
-        break;
-    }
-    if (!ctx->argument(0).isNumber() || !ctx->argument(1).isNumber()) {
-        ctx->throwError("Invalid arguments");
-        return QScriptValue();
-    }
-
-    const int from = ctx->argument(0).toInt32();
-    const int to = ctx->argument(1).toInt32();
-    if (from >= to) {
-        ctx->throwError("Invalid arguments");
-        return QScriptValue();
-    }
-
-    return (rand() % (to - from) + from) + 1;
-}
-
-#define TEST(op)                                                        \
-    if (engine.hasUncaughtException()) {                                \
-        qWarning("Exception %s at line %d\n",                           \
-                 qPrintable(engine.uncaughtException().toString()),     \
-                 engine.uncaughtExceptionLineNumber());                 \
-        return Failure;                                                 \
-    } else if (!(op)) {                                                 \
-        qWarning("%s failed", #op);                                     \
-        return Failure;                                                 \
-    }
-
-
-GraphicsScene::JavaScriptLoadState GraphicsScene::loadJavaScriptGame(QIODevice *device)
-{
-    const QString program = QTextStream(device).readAll();
-    QScriptEngine engine;
-    QScriptValue func = engine.newFunction(random);
-    engine.globalObject().setProperty("rand", func);
-    engine.evaluate(program);
-    if (engine.hasUncaughtException()) {
-        qDebug() << engine.uncaughtException().toString() << engine.uncaughtExceptionLineNumber();
-        return NotJavascript;
-    }
-    const QScriptValue categories = engine.evaluate("init()");
-    TEST(categories.isArray());
-    const int categoryCount = categories.property("length").toInt32();
-    TEST(categoryCount > 0);
-    QStringList topics;
-    QList<QPair<QString, QString> > frames;
-    for (int i=0; i<categoryCount; ++i) {
-        const QScriptValue category = categories.property(i);
-
-        TEST(category.isObject());
-        const QScriptValue topic = category.property("topic");
-        TEST(!topic.isNull());
-        topics.append(topic.toString());
-        const QScriptValue questions = category.property("questions");
-        TEST(questions.isArray() && questions.property("length").toInt32() == 5);
-        const QScriptValue answers = category.property("answers");
-        TEST(answers.isArray() && answers.property("length").toInt32() == 5);
-        for (int j=0; j<5; ++j) {
-            frames.append(qMakePair(questions.property(j).toString(), answers.property(j).toString()));
-        }
-    }
-    init(topics, frames);
-
-
-//     const QStringList categories = engine.evaluate("getCategories();").toVariant().toStringList();
-//     if (categories.isEmpty() || engine.hasUncaughtException())
-//         return false;
-//     qDebug() << categories;
-
-    return Success;
 }
@@ -3,109 +3,97 @@
 
 #include <QtGui>
 #include "items.h"
+#include "gamemodel.h"
+#include "stateengine.h"
 
-enum StateType {
-    Normal = 0,
-    ShowQuestion,
-    TimeOut,
-    PickTeam,
-    TeamTimedOut,
-    PickRightOrWrong,
-    WrongAnswer,
-    RightAnswer,
-    NoAnswers,
-    Finished,
-    NumStates
-};
-
-class Transition;
-class State : public QState
-{
-    Q_OBJECT
-    Q_PROPERTY(StateType type READ type WRITE setType)
-public:
-    State(StateType type, QState *parent) : QState(parent) { d.type = type; }
-    StateType type() const { return d.type; }
-    void setType(StateType type) { d.type = type; }
-    Transition *transition(StateType type) const { return d.transitions.value(type); }
-    void addTransition(StateType type, Transition *transition);
-private:
-    struct Data {
-        QHash<StateType, Transition *> transitions;
-        StateType type;
-    } d;
-};
-
-class Transition : public QSignalTransition
-{
-    Q_OBJECT
-public:
-    Transition(QObject *sender, State *target)
-        : QSignalTransition(sender, SIGNAL(next(int)))
-    {
-        setTargetState(target);
-    }
-    bool eventTest(QEvent *event)
-    {
-        if (QSignalTransition::eventTest(event)) {
-            QStateMachine::SignalEvent *se = static_cast<QStateMachine::SignalEvent*>(event);
-            Q_ASSERT(qobject_cast<State*>(targetState()));
-            return (se->arguments().value(0).toInt() == qobject_cast<State*>(targetState())->type());
-        }
-        return false;
-    }
-};
+struct GameData;
+class QuestionGenerator;
 
 typedef QHash<StateType, Transition*> TransitionHash;
+typedef QList<QPair<Item*, QRectF> > ItemGeometries;
 Q_DECLARE_METATYPE(TransitionHash);
+// Draws and animates a GameModel. Clicks are handed to the model and the
+// state machine follows the states the model goes through.
 class GraphicsScene : public QGraphicsScene
 {
     Q_OBJECT
 public:
     GraphicsScene(QObject *parent = 0);
+    ~GraphicsScene();
     bool load(QIODevice *device, const QStringList &teams);
+    bool setGame(const GameData &game, const QStringList &teams);
     void reset();
     void mousePressEvent(QGraphicsSceneMouseEvent *e);
     QRectF frameGeometry(Frame *frame) const;
     int answerTime() const;
     void setTeamGeometry(const QRectF &rect, Qt::Orientation orientation);
     void setupFinishState();
+    FaceAtlas *faceAtlas() { return &d.faceAtlas; }
+    StateType currentStateType() const { return d.currentState; }
+    bool isAnimating() const;
+    QList<Frame*> frames() const { return d.frames; }
+    QList<Team*> teams() const { return d.teams; }
+    QStringList teamNames() const;
+    Item *rightAnswerItem() const { return d.rightAnswerItem; }
+    Item *wrongAnswerItem() const { return d.wrongAnswerItem; }
+    bool isLayoutPending() const { return d.relayoutTimer.isActive() || !d.prewarmRequests.isEmpty(); }
+    int prewarmTime() const { return d.prewarmTime; }
+    GameModel *model() { return &d.model; }
 signals:
     void next(int type);
+    void layoutApplied();
+    void gameFinished();
     void mouseButtonPressed(const QPointF &, Qt::MouseButton);
 public slots:
-    void finishQuestion();
     bool load(const QString &file, const QStringList &teams = QStringList())
     { QFile f(file); return f.open(QIODevice::ReadOnly) && load(&f, teams); }
     void onClicked(Item *item);
+    void onFrameLowered();
+    void onZoomStateChanged(QAbstractAnimation::State state);
+    void onPrewarmFinished();
+    void relayout();
     void clearActiveFrame();
     void onSceneRectChanged(const QRectF &rect);
     void onStateEntered();
     void onStateExited();
-    void nextStateTimeOut() { emit next(TimeOut); }
+    void onStateEntered(StateType type);
+    void onStateExited(StateType type);
+    void onModelStateChanged(StateType state);
+    void onFrameStatusChanged(int frame, GameModel::FrameStatus status);
+    void onPointsChanged(int team, int points);
+    void nextStateTimeOut() { d.model.timeOut(); }
+    void onFrameHovered(Item *item);
+    void retryClick();
 private:
-    enum JavaScriptLoadState {
-        Success,
-        Failure,
-        NotJavascript
-    };
-    JavaScriptLoadState loadJavaScriptGame(QIODevice *device);
-
     void init(const QStringList &categories, const QList<QPair<QString, QString> > &frames);
+    void generateQuestion(Frame *frame);
+    void prewarm(const QRectF &rect);
+    ItemGeometries itemGeometries(const QRectF &rect) const;
+    ItemGeometries teamGeometries(const QRectF &rect, Qt::Orientation orientation) const;
+    void applyLayout(const QRectF &rect);
+    void startStates();
+    void assignProperty(StateType state, QObject *object, const char *name, const QVariant &value);
+    void addAnimation(StateType from, StateType to, QAbstractAnimation *animation);
     Transition *transition(StateType from, StateType to) const;
     Transition *addTransition(StateType from, StateType to);
 
     struct Data {
+        GameModel model;
+        bool stateEngine;
+        StateEngine engine;
         QStateMachine stateMachine;
         State *states[NumStates];
-        State *currentState;
+        StateType currentState;
         QList<Team*> teams;
         Team *cancelTeam;
-        QSet<Team*> teamsAttempted;
 
         QList<Frame*> frames;
-        int framesLeft;
-        int right, wrong, timedout;
+        QSharedPointer<QFile> gameStorage;
+        QSharedPointer<QuestionGenerator> generator;
+        QSet<Frame*> ungeneratedFrames, prefetchedFrames;
+        // Clicked while its question was still being generated
+        QPointer<Frame> retryFrame;
+        QTimer retryTimer;
 
         Frame *currentFrame;
 
@@ -119,6 +107,21 @@ private:
         QTimer timeoutTimer;
         QTime timeoutTimerStarted;
         int elapsed;
+        FaceAtlas faceAtlas;
+        QFutureWatcher<QImage> prewarmWatcher;
+        QList<FaceRequest> prewarmRequests;
+        QRectF prewarmRect;
+        QElapsedTimer prewarmTimer;
+        int prewarmTime;
+        QTimer relayoutTimer;
+        QRectF relayoutRect;
+        bool layoutAssigned;
+
+        bool zoomTransform;
+        QByteArray frameGeometryProperty;
+        QElapsedTimer zoomTimer;
+        int zoomPaints;
+        qint64 zoomPaintTime;
     } d;
 };
 
@@ -0,0 +1,370 @@
+#include <QtCore>
+#include <math.h>
+#include <stdio.h>
+#include "gamemodel.h"
+#include "random.h"
+#include "arguments.h"
+
+// Plays a lot of games on GameModel with made up teams to see how board
+// values and the wrong answer penalty play out. Every game is seeded from
+// --seed and its number alone, so the results don't depend on how many
+// threads there are or which one played which game.
+
+struct TeamSkill
+{
+    QString name;
+    // Buzzes per second, reaction times are exponential
+    double speed;
+    // Chance of a right answer, per category. Categories past the end
+    // of the list reuse it from the start.
+    QVector<double> accuracy;
+};
+
+struct Simulation
+{
+    int games, chunkSize, categories;
+    double timeLimit;
+    quint64 seed;
+    QList<TeamSkill> teams;
+    QList<int> penalties;
+
+    // Workers take chunks of games off this until there are none left
+    QAtomicInt nextChunk;
+};
+
+// Results for one penalty. Every score is a multiple of bucketWidth
+// between minScore and maxScore, so the histograms have a bucket for each
+// possible score and the percentiles are exact.
+struct PenaltyStats
+{
+    void init(int teams, int minScore, int maxScore, int bucketWidth)
+    {
+        this->minScore = minScore;
+        this->bucketWidth = bucketWidth;
+        const int buckets = ((maxScore - minScore) / bucketWidth) + 1;
+        histograms.fill(0, teams * buckets);
+        wins.fill(0, teams);
+        sum.fill(0, teams);
+        sumSquares.fill(0, teams);
+        ties = leadChanges = winnerChanged = 0;
+    }
+    void merge(const PenaltyStats &other)
+    {
+        for (int i=0; i<histograms.size(); ++i)
+            histograms[i] += other.histograms.at(i);
+        for (int i=0; i<wins.size(); ++i) {
+            wins[i] += other.wins.at(i);
+            sum[i] += other.sum.at(i);
+            sumSquares[i] += other.sumSquares.at(i);
+        }
+        ties += other.ties;
+        leadChanges += other.leadChanges;
+        winnerChanged += other.winnerChanged;
+    }
+    int buckets() const { return wins.isEmpty() ? 0 : histograms.size() / wins.size(); }
+    void addScore(int team, int score)
+    {
+        Q_ASSERT(score >= minScore && !((score - minScore) % bucketWidth));
+        const int bucket = qBound(0, (score - minScore) / bucketWidth, buckets() - 1);
+        ++histograms[team * buckets() + bucket];
+        sum[team] += score;
+        sumSquares[team] += double(score) * score;
+    }
+    int percentile(int team, quint64 games, int percent) const
+    {
+        const quint64 wanted = (games * percent) / 100;
+        quint64 seen = 0;
+        const int count = buckets();
+        for (int i=0; i<count; ++i) {
+            seen += histograms.at(team * count + i);
+            if (seen > wanted)
+                return minScore + (i * bucketWidth);
+        }
+        return minScore + ((count - 1) * bucketWidth);
+    }
+
+    int minScore, bucketWidth;
+    QVector<quint64> histograms;
+    QVector<quint64> wins;
+    QVector<double> sum, sumSquares;
+    quint64 ties, leadChanges, winnerChanged;
+};
+
+struct SimulationStats
+{
+    SimulationStats() : games(0) {}
+
+    quint64 games;
+    QVector<PenaltyStats> penalties;
+};
+
+static int gcd(int a, int b)
+{
+    while (b) {
+        const int t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+// Per frame a team gets its value, loses the penalty or gets nothing.
+// Returns the gcd of everything that can be added up, every score is a
+// multiple of it between minScore and maxScore.
+static int scoreRange(const GameModel &model, int penalty, int *minScore, int *maxScore)
+{
+    int width = 0;
+    *minScore = *maxScore = 0;
+    for (int i=0; i<model.frameCount(); ++i) {
+        const int right = model.value(i);
+        // Rounded the way GameModel does it
+        const int wrong = -(right * penalty) / 100;
+        *minScore += qMin(0, qMin(right, wrong));
+        *maxScore += qMax(0, qMax(right, wrong));
+        width = gcd(gcd(width, right), qAbs(wrong));
+    }
+    return qMax(width, 1);
+}
+
+static int leader(const GameModel &model)
+{
+    int best = -1;
+    bool tied = false;
+    for (int i=0; i<model.teamCount(); ++i) {
+        if (best == -1 || model.points(i) > model.points(best)) {
+            best = i;
+            tied = false;
+        } else if (model.points(i) == model.points(best)) {
+            tied = true;
+        }
+    }
+    return tied ? -1 : best;
+}
+
+// Plays one game and returns the winner, -1 for a tie. The moves only
+// depend on random, never on the score, so the same seed plays the same
+// game under every penalty.
+static int play(const Simulation *simulation, GameModel *model, Random *random, PenaltyStats *stats)
+{
+    const int teamCount = model->teamCount();
+    int lead = -1;
+    while (model->state() != Finished) {
+        switch (model->state()) {
+        case Normal: {
+            int frame = random->bounded(model->frameCount());
+            while (model->frameStatus(frame) != GameModel::Hidden) {
+                if (++frame == model->frameCount())
+                    frame = 0;
+            }
+            model->pickFrame(frame);
+            break; }
+        case ShowQuestion: {
+            // The fastest team that hasn't tried yet buzzes in
+            int fastest = -1;
+            double best = simulation->timeLimit;
+            for (int i=0; i<teamCount; ++i) {
+                const double reaction = -log(1.0 - random->uniform()) / simulation->teams.at(i).speed;
+                if (!model->hasAttempted(i) && reaction < best) {
+                    best = reaction;
+                    fastest = i;
+                }
+            }
+            if (fastest == -1) {
+                model->timeOut();
+            } else {
+                model->stopClock();
+                model->pickTeam(fastest);
+            }
+            break; }
+        case PickRightOrWrong: {
+            const QVector<double> &accuracy = simulation->teams.at(model->activeTeam()).accuracy;
+            const int category = model->currentFrame() / GameModel::QuestionsPerCategory;
+            model->answer(random->uniform() < accuracy.at(category % accuracy.size()));
+            break; }
+        case RightAnswer:
+            model->finishQuestion();
+            break;
+        default:
+            Q_ASSERT(0);
+            return -1;
+        }
+        if (model->state() == Normal || model->state() == Finished) {
+            const int current = leader(*model);
+            if (current != -1 && lead != -1 && current != lead)
+                ++stats->leadChanges;
+            if (current != -1)
+                lead = current;
+        }
+    }
+
+    for (int i=0; i<teamCount; ++i)
+        stats->addScore(i, model->points(i));
+    const int winner = leader(*model);
+    if (winner == -1) {
+        ++stats->ties;
+    } else {
+        ++stats->wins[winner];
+    }
+    return winner;
+}
+
+static SimulationStats simulate(Simulation *simulation)
+{
+    const int teamCount = simulation->teams.size();
+    const int penaltyCount = simulation->penalties.size();
+
+    QStringList categories, teams;
+    QList<QPair<QString, QString> > frames;
+    for (int i=0; i<simulation->categories; ++i) {
+        categories.append(QString());
+        for (int j=0; j<GameModel::QuestionsPerCategory; ++j)
+            frames.append(qMakePair(QString(), QString()));
+    }
+    foreach(const TeamSkill &team, simulation->teams)
+        teams.append(team.name);
+
+    GameModel model;
+    model.setGame(categories, frames, teams);
+    SimulationStats stats;
+    stats.penalties.resize(penaltyCount);
+    for (int i=0; i<penaltyCount; ++i) {
+        int minScore, maxScore;
+        const int width = scoreRange(model, simulation->penalties.at(i), &minScore, &maxScore);
+        stats.penalties[i].init(teamCount, minScore, maxScore, width);
+    }
+
+    Random random;
+    const int chunks = (simulation->games + simulation->chunkSize - 1) / simulation->chunkSize;
+    forever {
+        const int chunk = simulation->nextChunk.fetchAndAddRelaxed(1);
+        if (chunk >= chunks)
+            break;
+        const int last = qMin(simulation->games, (chunk + 1) * simulation->chunkSize);
+        for (int game=chunk * simulation->chunkSize; game<last; ++game) {
+            const quint64 seed = Random::mix(simulation->seed + quint64(game));
+            int firstWinner = -1;
+            for (int p=0; p<penaltyCount; ++p) {
+                random.setSeed(seed);
+                model.setWrongAnswerPenalty(simulation->penalties.at(p));
+                model.setGame(categories, frames, teams);
+                const int winner = play(simulation, &model, &random, &stats.penalties[p]);
+                if (p == 0) {
+                    firstWinner = winner;
+                } else if (winner != firstWinner) {
+                    ++stats.penalties[p].winnerChanged;
+                }
+            }
+            ++stats.games;
+        }
+    }
+    return stats;
+}
+
+// name:speed:accuracy[,accuracy...]
+static bool parseTeam(const QString &string, TeamSkill *team)
+{
+    const QStringList parts = string.split(':');
+    if (parts.size() != 3 || parts.at(0).isEmpty())
+        return false;
+    bool ok;
+    team->name = parts.at(0);
+    team->speed = parts.at(1).toDouble(&ok);
+    if (!ok || team->speed <= 0.0)
+        return false;
+    team->accuracy.clear();
+    foreach(const QString &accuracy, parts.at(2).split(',')) {
+        team->accuracy.append(accuracy.toDouble(&ok));
+        if (!ok || team->accuracy.last() < 0.0 || team->accuracy.last() > 1.0)
+            return false;
+    }
+    return true;
+}
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr, "Usage: %s [--games=N] [--threads=N] [--seed=S] [--categories=N]\n"
+            "       [--time-limit=seconds] [--penalties=percent,...] [--chunk=games]\n"
+            "       [--team=name:speed:accuracy[,accuracy...]]...\n", argv0);
+}
+
+int main(int argc, char **argv)
+{
+    QCoreApplication a(argc, argv);
+    const QStringList args = a.arguments();
+
+    Simulation simulation;
+    simulation.games = argumentValue(args, "games", "1000000").toInt();
+    simulation.chunkSize = argumentValue(args, "chunk", "1024").toInt();
+    simulation.categories = argumentValue(args, "categories", "6").toInt();
+    simulation.timeLimit = argumentValue(args, "time-limit", "5").toDouble();
+    simulation.seed = Random::nextSeed();
+    foreach(const QString &penalty, argumentValue(args, "penalties", "50,0").split(','))
+        simulation.penalties.append(penalty.toInt());
+    foreach(const QString &arg, args) {
+        if (arg.startsWith("--team=")) {
+            TeamSkill team;
+            if (!parseTeam(arg.mid(7), &team)) {
+                fprintf(stderr, "Can't parse %s\n", qPrintable(arg));
+                usage(argv[0]);
+                return 1;
+            }
+            simulation.teams.append(team);
+        }
+    }
+    if (simulation.teams.isEmpty()) {
+        const char *defaults[] = {
+            "Fast:1.5:0.6", "Steady:1.0:0.8", "Specialist:1.0:0.95,0.5", 0
+        };
+        for (int i=0; defaults[i]; ++i) {
+            TeamSkill team;
+            parseTeam(QString::fromLatin1(defaults[i]), &team);
+            simulation.teams.append(team);
+        }
+    }
+    const int threads = argumentValue(args, "threads", QString::number(QThread::idealThreadCount())).toInt();
+    if (simulation.games <= 0 || simulation.chunkSize <= 0 || simulation.categories <= 0
+        || simulation.timeLimit <= 0.0 || threads <= 0 || simulation.teams.size() < 2) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    QThreadPool::globalInstance()->setMaxThreadCount(threads);
+    QElapsedTimer timer;
+    timer.start();
+    QList<QFuture<SimulationStats> > futures;
+    for (int i=0; i<threads; ++i)
+        futures.append(QtConcurrent::run(simulate, &simulation));
+    SimulationStats stats = futures.first().result();
+    for (int i=1; i<futures.size(); ++i) {
+        const SimulationStats other = futures.at(i).result();
+        stats.games += other.games;
+        for (int p=0; p<stats.penalties.size(); ++p)
+            stats.penalties[p].merge(other.penalties.at(p));
+    }
+    const qint64 elapsed = timer.elapsed();
+
+    printf("%llu games of %d categories on %d threads in %lld ms (%.0f games/s), seed %llu\n",
+           stats.games, simulation.categories, threads, elapsed,
+           elapsed ? stats.games * 1000.0 / elapsed : 0.0, simulation.seed);
+    const double games = double(stats.games);
+    for (int p=0; p<stats.penalties.size(); ++p) {
+        const PenaltyStats &penalty = stats.penalties.at(p);
+        printf("\nWrong answers cost %d%% of the value\n", simulation.penalties.at(p));
+        printf("%-16s %8s %9s %9s %8s %8s %8s\n", "team", "wins", "mean", "stddev", "p5", "p50", "p95");
+        for (int t=0; t<simulation.teams.size(); ++t) {
+            const double mean = penalty.sum.at(t) / games;
+            const double variance = qMax(0.0, penalty.sumSquares.at(t) / games - mean * mean);
+            printf("%-16s %7.2f%% %9.1f %9.1f %8d %8d %8d\n", qPrintable(simulation.teams.at(t).name),
+                   penalty.wins.at(t) * 100.0 / games, mean, sqrt(variance),
+                   penalty.percentile(t, stats.games, 5), penalty.percentile(t, stats.games, 50),
+                   penalty.percentile(t, stats.games, 95));
+        }
+        printf("%-16s %7.2f%%\n", "ties", penalty.ties * 100.0 / games);
+        printf("%.2f lead changes per game\n", penalty.leadChanges / games);
+        if (p > 0) {
+            printf("%.2f%% of the games have a different winner than at %d%%\n",
+                   penalty.winnerChanged * 100.0 / games, simulation.penalties.first());
+        }
+    }
+    return 0;
+}
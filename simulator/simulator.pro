@@ -0,0 +1,20 @@
+TEMPLATE = app
+TARGET =
+DEPENDPATH += . ..
+INCLUDEPATH += . ..
+
+# Input
+HEADERS += ../gamemodel.h ../random.h ../arguments.h
+SOURCES += main.cpp ../gamemodel.cpp ../random.cpp ../arguments.cpp
+CONFIG += debug
+unix {
+    MOC_DIR=.moc
+    UI_DIR=.ui
+    OBJECTS_DIR=.obj
+} else {
+    MOC_DIR=tmp/moc
+    UI_DIR=tmp/ui
+    OBJECTS_DIR=tmp/obj
+}
+QT = core
+CONFIG -= app_bundle
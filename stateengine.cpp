@@ -0,0 +1,137 @@
+#include "stateengine.h"
+
+void State::addTransition(StateType type, Transition *transition)
+{
+    d.transitions[type] = transition;
+    QState::addTransition(transition);
+}
+
+StateEngine::StateEngine(QObject *parent)
+    : QObject(parent)
+{
+    d.state = NumStates;
+}
+
+void StateEngine::setState(StateType state)
+{
+    Q_ASSERT(state >= 0 && state < NumStates);
+    finishAnimations();
+    if (d.state != NumStates)
+        emit exited(d.state);
+    assign(QList<QAbstractAnimation*>(), d.assignments[state]);
+    d.state = state;
+    emit entered(state);
+}
+
+void StateEngine::assignProperty(StateType state, QObject *object, const char *name, const QVariant &value)
+{
+    QVector<Assignment> &assignments = d.assignments[state];
+    for (int i=assignments.size() - 1; i>=0; --i) {
+        if (!assignments.at(i).object) {
+            // Items of the previous game
+            assignments.remove(i);
+        } else if (assignments.at(i).object == object && assignments.at(i).name == name) {
+            assignments[i].value = value;
+            return;
+        }
+    }
+    Assignment assignment;
+    assignment.object = object;
+    assignment.name = name;
+    assignment.value = value;
+    assignment.animation = 0;
+    assignments.append(assignment);
+}
+
+void StateEngine::addAnimation(StateType from, StateType to, QAbstractAnimation *animation)
+{
+    Q_ASSERT(GameModel::isTransition(from, to));
+    d.animations[from][to].append(animation);
+}
+
+void StateEngine::next(int type)
+{
+    if (type < 0 || type >= NumStates || d.state == NumStates)
+        return;
+    const StateType from = d.state;
+    const StateType to = static_cast<StateType>(type);
+    if (!GameModel::isTransition(from, to))
+        return;
+
+    finishAnimations();
+    emit exited(from);
+    assign(d.animations[from][to], d.assignments[to]);
+    d.state = to;
+    emit entered(to);
+}
+
+void StateEngine::finishAnimations()
+{
+    if (d.running.isEmpty())
+        return;
+    foreach(QAbstractAnimation *animation, d.running)
+        animation->stop();
+    d.running.clear();
+    foreach(const Assignment &assignment, d.animated) {
+        if (assignment.object)
+            assignment.object->setProperty(assignment.name.constData(), assignment.value);
+    }
+    d.animated.clear();
+}
+
+void StateEngine::onAnimationFinished()
+{
+    QAbstractAnimation *animation = static_cast<QAbstractAnimation*>(sender());
+    d.running.removeAll(animation);
+    for (int i=d.animated.size() - 1; i>=0; --i) {
+        if (d.animated.at(i).animation == animation)
+            d.animated.remove(i);
+    }
+}
+
+static QPropertyAnimation *findAnimation(QAbstractAnimation *animation, QObject *object, const QByteArray &name)
+{
+    if (QPropertyAnimation *property = qobject_cast<QPropertyAnimation*>(animation)) {
+        return (property->targetObject() == object && property->propertyName() == name) ? property : 0;
+    } else if (QAnimationGroup *group = qobject_cast<QAnimationGroup*>(animation)) {
+        for (int i=0; i<group->animationCount(); ++i) {
+            if (QPropertyAnimation *property = findAnimation(group->animationAt(i), object, name))
+                return property;
+        }
+    }
+    return 0;
+}
+
+void StateEngine::assign(const QList<QAbstractAnimation*> &animations, const QVector<Assignment> &assignments)
+{
+    QVarLengthArray<bool, 8> used(animations.size());
+    for (int j=0; j<animations.size(); ++j)
+        used[j] = false;
+    for (int i=0; i<assignments.size(); ++i) {
+        const Assignment &assignment = assignments.at(i);
+        if (!assignment.object)
+            continue;
+        QPropertyAnimation *property = 0;
+        for (int j=0; !property && j<animations.size(); ++j) {
+            property = findAnimation(animations.at(j), assignment.object, assignment.name);
+            if (property) {
+                used[j] = true;
+                d.animated.append(assignment);
+                d.animated.last().animation = animations.at(j);
+            }
+        }
+        if (property) {
+            property->setEndValue(assignment.value);
+        } else {
+            assignment.object->setProperty(assignment.name.constData(), assignment.value);
+        }
+    }
+    for (int j=0; j<animations.size(); ++j) {
+        if (used[j]) {
+            connect(animations.at(j), SIGNAL(finished()), this, SLOT(onAnimationFinished()),
+                    Qt::UniqueConnection);
+            animations.at(j)->start();
+            d.running.append(animations.at(j));
+        }
+    }
+}
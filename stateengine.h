@@ -0,0 +1,97 @@
+#ifndef STATEENGINE_H
+#define STATEENGINE_H
+
+#include <QtCore>
+#include "gamemodel.h"
+
+// The QStateMachine side. State knows which StateType it is and
+// Transition takes a next(int) signal for its target state only.
+class Transition;
+class State : public QState
+{
+    Q_OBJECT
+    Q_PROPERTY(StateType type READ type WRITE setType)
+public:
+    State(StateType type, QState *parent) : QState(parent) { d.type = type; }
+    StateType type() const { return d.type; }
+    void setType(StateType type) { d.type = type; }
+    Transition *transition(StateType type) const { return d.transitions.value(type); }
+    void addTransition(StateType type, Transition *transition);
+private:
+    struct Data {
+        QHash<StateType, Transition *> transitions;
+        StateType type;
+    } d;
+};
+
+class Transition : public QSignalTransition
+{
+    Q_OBJECT
+public:
+    Transition(QObject *sender, State *target)
+        : QSignalTransition(sender, SIGNAL(next(int)))
+    {
+        setTargetState(target);
+    }
+    bool eventTest(QEvent *event)
+    {
+        if (QSignalTransition::eventTest(event)) {
+            QStateMachine::SignalEvent *se = static_cast<QStateMachine::SignalEvent*>(event);
+            Q_ASSERT(qobject_cast<State*>(targetState()));
+            return (se->arguments().value(0).toInt() == qobject_cast<State*>(targetState())->type());
+        }
+        return false;
+    }
+};
+
+// Walks the graph in GameModel::isTransition the way GraphicsScene used
+// QStateMachine, without posting events or matching signal arguments.
+// next() looks the edge up in the transition table, leaves the current
+// state, assigns the new state's properties and enters it before it
+// returns.
+//
+// Assignments whose property is animated by one of the transition's
+// animations become the animation's end value, everything else is set
+// right away. A transition taken while animations are still running
+// stops them and sets their end values first, animations that have
+// finished are forgotten.
+class StateEngine : public QObject
+{
+    Q_OBJECT
+public:
+    StateEngine(QObject *parent = 0);
+
+    StateType state() const { return d.state; }
+    // Jumps to state without a transition
+    void setState(StateType state);
+
+    void assignProperty(StateType state, QObject *object, const char *name, const QVariant &value);
+    void addAnimation(StateType from, StateType to, QAbstractAnimation *animation);
+public slots:
+    void next(int type);
+signals:
+    void entered(StateType state);
+    void exited(StateType state);
+private slots:
+    void onAnimationFinished();
+private:
+    struct Assignment {
+        QPointer<QObject> object;
+        QByteArray name;
+        QVariant value;
+        // The transition animation that ends in value, if any
+        QAbstractAnimation *animation;
+    };
+    void finishAnimations();
+    void assign(const QList<QAbstractAnimation*> &animations, const QVector<Assignment> &assignments);
+
+    struct Data {
+        StateType state;
+        QVector<Assignment> assignments[NumStates];
+        QList<QAbstractAnimation*> animations[NumStates][NumStates];
+        QList<QAbstractAnimation*> running;
+        QVector<Assignment> animated;
+    } d;
+};
+
+#endif
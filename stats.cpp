@@ -0,0 +1,140 @@
+#include "stats.h"
+#include "scene.h"
+#ifdef Q_OS_UNIX
+#include <unistd.h>
+#endif
+
+static inline double msecs(qint64 nsecs)
+{
+    return double(nsecs) / 1000000.0;
+}
+
+RenderStats::RenderStats()
+{
+    d.clock.start();
+    d.lastFrame = 0;
+}
+
+RenderStats *RenderStats::instance()
+{
+    static RenderStats stats;
+    return &stats;
+}
+
+bool RenderStats::isEnabled()
+{
+    static const bool enabled = QCoreApplication::arguments().contains("--stats");
+    return enabled;
+}
+
+QString RenderStats::fileName()
+{
+    foreach(const QString &arg, QCoreApplication::arguments()) {
+        if (arg.startsWith("--stats-file="))
+            return arg.mid(13);
+    }
+    return QLatin1String("jeopardy-stats.txt");
+}
+
+void RenderStats::addFrame(qint64 nsecs)
+{
+    const qint64 now = d.clock.elapsed();
+    d.frameTimestamps.enqueue(now);
+    while (d.frameTimestamps.head() < now - 1000)
+        d.frameTimestamps.dequeue();
+    d.frames.add(nsecs);
+    d.lastFrame = nsecs;
+}
+
+void RenderStats::addPaint(const Item *item, qint64 nsecs)
+{
+    PaintStats &stats = d.items[item];
+    // Text of compiled games points into the file they were loaded from,
+    // which goes away with the game
+    const QString text = item->text();
+    if (stats.name != text)
+        stats.name = QString(text.constData(), text.size());
+    stats.add(nsecs);
+
+    PaintStats &type = d.types[item->type()];
+    if (type.name.isEmpty()) {
+        switch (item->type()) {
+        case Frame::Type: type.name = QLatin1String("frames"); break;
+        case Team::Type: type.name = QLatin1String("teams"); break;
+        default: type.name = QLatin1String("items"); break;
+        }
+    }
+    type.add(nsecs);
+}
+
+bool RenderStats::compareByTotal(const PaintStats &left, const PaintStats &right)
+{
+    return left.total > right.total;
+}
+
+QStringList RenderStats::report(GraphicsScene *scene) const
+{
+    QStringList lines;
+    lines << QString("%1 fps, frame %2 ms, worst frame %3 ms, %4 frames").
+        arg(d.frameTimestamps.size()).arg(msecs(d.lastFrame), 0, 'f', 2).
+        arg(msecs(d.frames.worst), 0, 'f', 2).arg(d.frames.count);
+
+    for (QHash<int, PaintStats>::const_iterator it = d.types.begin(); it != d.types.end(); ++it) {
+        const PaintStats &type = it.value();
+        lines << QString("%1: %2 paints, %3 ms avg, %4 ms worst").arg(type.name).arg(type.count).
+            arg(msecs(type.total / type.count), 0, 'f', 3).arg(msecs(type.worst), 0, 'f', 3);
+    }
+
+    QList<PaintStats> items = d.items.values();
+    qSort(items.begin(), items.end(), compareByTotal);
+    enum { SlowestItems = 3 };
+    for (int i=0; i<qMin<int>(SlowestItems, items.size()); ++i) {
+        const PaintStats &item = items.at(i);
+        lines << QString("\"%1\": %2 paints, %3 ms avg, %4 ms worst").arg(item.name.left(30)).
+            arg(item.count).arg(msecs(item.total / item.count), 0, 'f', 3).arg(msecs(item.worst), 0, 'f', 3);
+    }
+
+    const TextLayoutCache *layouts = TextLayoutCache::instance();
+    lines << QString("text layouts: %1 cached, %2 hits, %3 misses").
+        arg(layouts->count()).arg(layouts->hits()).arg(layouts->misses());
+    if (scene) {
+        const FaceAtlas *atlas = scene->faceAtlas();
+        lines << QString("faces: %1 cached, %2 KB, %3 hits, %4 misses").
+            arg(atlas->count()).arg(atlas->memory() / 1024).arg(atlas->hits()).arg(atlas->misses());
+        lines << QString("pre-warm: %1 ms").arg(scene->prewarmTime());
+    }
+    return lines;
+}
+
+static QString hostName()
+{
+#ifdef Q_OS_UNIX
+    char name[256];
+    if (!gethostname(name, sizeof(name))) {
+        name[sizeof(name) - 1] = '\0';
+        return QString::fromLocal8Bit(name);
+    }
+    return QString();
+#else
+    return QString::fromLocal8Bit(qgetenv("COMPUTERNAME"));
+#endif
+}
+
+bool RenderStats::dump(GraphicsScene *scene) const
+{
+    QFile file(fileName());
+    if (!file.open(QIODevice::WriteOnly|QIODevice::Truncate)) {
+        qWarning("Can't open %s for writing", qPrintable(file.fileName()));
+        return false;
+    }
+    QTextStream ts(&file);
+    ts << "date: " << QDateTime::currentDateTime().toString(Qt::ISODate) << endl
+       << "host: " << hostName() << endl
+       << "qt: " << qVersion() << endl
+       << "threads: " << QThread::idealThreadCount() << endl
+       << "screen: " << QApplication::desktop()->screenGeometry().width() << 'x'
+       << QApplication::desktop()->screenGeometry().height() << endl;
+    foreach(const QString &line, report(scene))
+        ts << line << endl;
+    return true;
+}
@@ -0,0 +1,43 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <QtGui>
+
+class Item;
+class GraphicsScene;
+class RenderStats
+{
+public:
+    static RenderStats *instance();
+    static bool isEnabled();
+    static QString fileName();
+
+    void addFrame(qint64 nsecs);
+    void addPaint(const Item *item, qint64 nsecs);
+    void removeItem(const Item *item) { d.items.remove(item); }
+
+    QStringList report(GraphicsScene *scene) const;
+    bool dump(GraphicsScene *scene) const;
+private:
+    RenderStats();
+    struct PaintStats {
+        PaintStats() : count(0), total(0), worst(0) {}
+        void add(qint64 nsecs) { ++count; total += nsecs; worst = qMax(worst, nsecs); }
+
+        QString name;
+        int count;
+        qint64 total, worst;
+    };
+    static bool compareByTotal(const PaintStats &left, const PaintStats &right);
+
+    struct Data {
+        QElapsedTimer clock;
+        QQueue<qint64> frameTimestamps;
+        PaintStats frames;
+        qint64 lastFrame;
+        QHash<const Item*, PaintStats> items;
+        QHash<int, PaintStats> types;
+    } d;
+};
+
+#endif
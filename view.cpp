@@ -1,5 +1,6 @@
 #include "view.h"
 #include "scene.h"
+#include "stats.h"
 
 MainWindow::MainWindow()
     : QMainWindow()
@@ -33,9 +34,17 @@ GraphicsView::GraphicsView(QWidget *parent)
 {
     setContextMenuPolicy(Qt::ActionsContextMenu);
     setBackgroundBrush(Qt::red);
-    d.scene = 0;
+    d.scene = d.pendingScene = 0;
     setHorizontalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
     setVerticalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
+    if (RenderStats::isEnabled())
+        setViewportUpdateMode(FullViewportUpdate);
+
+    d.progressBar = new QProgressBar(this);
+    d.progressBar->hide();
+    d.progressTimer.setInterval(100);
+    connect(&d.progressTimer, SIGNAL(timeout()), this, SLOT(updateLoadProgress()));
+    connect(&d.loadWatcher, SIGNAL(finished()), this, SLOT(onGameLoaded()));
 
     QAction *action = new QAction(tr("&New game"), this);
     action->setShortcut(QKeySequence::New);
@@ -46,6 +55,18 @@ GraphicsView::GraphicsView(QWidget *parent)
     connect(action, SIGNAL(triggered(bool)), this, SLOT(createGame()));
     addAction(action);
 
+    d.reloadAction = new QAction(tr("&Reload game"), this);
+    d.reloadAction->setShortcut(QKeySequence::Refresh);
+    d.reloadAction->setEnabled(false);
+    connect(d.reloadAction, SIGNAL(triggered(bool)), this, SLOT(reloadGame()));
+    addAction(d.reloadAction);
+
+    d.cancelLoadAction = new QAction(tr("C&ancel loading"), this);
+    d.cancelLoadAction->setShortcut(Qt::Key_Escape);
+    d.cancelLoadAction->setEnabled(false);
+    connect(d.cancelLoadAction, SIGNAL(triggered(bool)), this, SLOT(cancelLoad()));
+    addAction(d.cancelLoadAction);
+
     action = new QAction(this);
     action->setSeparator(true);
     addAction(action);
@@ -54,14 +75,79 @@ GraphicsView::GraphicsView(QWidget *parent)
     action->setShortcut(QKeySequence::Quit);
     connect(action, SIGNAL(triggered(bool)), window(), SLOT(close()));
     addAction(action);
+
+    foreach(const QString &arg, QCoreApplication::arguments()) {
+        if (arg.startsWith("--journal=")) {
+            QString error;
+            if (!d.journal.open(arg.mid(10), &error))
+                qWarning("Can't open journal %s: %s", qPrintable(arg.mid(10)), qPrintable(error));
+        }
+    }
+}
+
+GraphicsView::~GraphicsView()
+{
+    // Don't leave a script running in the thread pool on the way out
+    cancelLoad();
+    d.loadWatcher.waitForFinished();
 }
 
 void GraphicsView::resizeEvent(QResizeEvent *e)
 {
     QGraphicsView::resizeEvent(e);
+    enum { Margin = 20 };
+    const int height = d.progressBar->sizeHint().height();
+    d.progressBar->setGeometry(Margin, e->size().height() - height - Margin,
+                               e->size().width() - (Margin * 2), height);
     if (scene())
         scene()->setSceneRect(rect());
 }
+void GraphicsView::paintEvent(QPaintEvent *e)
+{
+    if (!RenderStats::isEnabled()) {
+        QGraphicsView::paintEvent(e);
+        return;
+    }
+    QElapsedTimer timer;
+    timer.start();
+    QGraphicsView::paintEvent(e);
+    RenderStats::instance()->addFrame(timer.nsecsElapsed());
+}
+
+void GraphicsView::drawForeground(QPainter *painter, const QRectF &rect)
+{
+    QGraphicsView::drawForeground(painter, rect);
+    if (!RenderStats::isEnabled())
+        return;
+
+    const QStringList lines = RenderStats::instance()->report(d.scene);
+    painter->save();
+    painter->resetTransform();
+    QFont font;
+    font.setPixelSize(12);
+    painter->setFont(font);
+    const QFontMetrics fm(font);
+    enum { Margin = 4 };
+    int width = 0;
+    foreach(const QString &line, lines)
+        width = qMax(width, fm.width(line));
+    const QRect r(Margin, Margin, width + (Margin * 2), (fm.height() * lines.size()) + (Margin * 2));
+    painter->fillRect(r, QColor(0, 0, 0, 180));
+    painter->setPen(Qt::white);
+    int y = r.top() + Margin + fm.ascent();
+    foreach(const QString &line, lines) {
+        painter->drawText(r.left() + Margin, y, line);
+        y += fm.height();
+    }
+    painter->restore();
+}
+
+void GraphicsView::onGameFinished()
+{
+    if (RenderStats::isEnabled())
+        RenderStats::instance()->dump(d.scene);
+}
+
 QSize GraphicsView::sizeHint() const
 {
     return QSize(800, 600);
@@ -72,7 +158,7 @@ void GraphicsView::newGame()
     QSettings settings;
     const QString directory = settings.value("lastDirectory", QCoreApplication::applicationDirPath()).toString();
 
-    const QString file = QFileDialog::getOpenFileName(this, "Choose game", directory, "Games (*.jgm *.js)");
+    const QString file = QFileDialog::getOpenFileName(this, "Choose game", directory, "Games (*.jgm *.jgmb *.js)");
     if (QFile::exists(file)) {
         settings.setValue("lastDirectory", QFileInfo(file).absolutePath());
         load(file);
@@ -341,17 +427,125 @@ void GraphicsView::createGame()
     }
 }
 
+static GameLoadResult loadGame(const QString &fileName, QSharedPointer<LoadProgress> progress)
+{
+    GameLoadResult result;
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        result.error = QString("Can't open %1 for reading").arg(fileName);
+        return result;
+    }
+    result.ok = GameLoader::load(&file, &result.game, &result.error, progress.data());
+    // The mapping goes away with the scene, on the GUI thread
+    if (result.game.storage)
+        result.game.storage->moveToThread(QCoreApplication::instance()->thread());
+    return result;
+}
+
 void GraphicsView::load(const QString &fileName, const QStringList &players)
 {
+    // Parsing and running scripts happens in the thread pool. The current
+    // game stays up and playable until the new one is ready.
+    cancelLoad();
+    d.loadProgress = QSharedPointer<LoadProgress>(new LoadProgress);
+    d.loadPlayers = players;
+    d.loadFile = fileName;
+    d.progressBar->setFormat(tr("Loading %1 %p%").arg(QFileInfo(fileName).fileName()));
+    updateLoadProgress();
+    d.progressBar->show();
+    d.progressTimer.start();
+    d.cancelLoadAction->setEnabled(true);
+    d.loadWatcher.setFuture(QtConcurrent::run(loadGame, fileName, d.loadProgress));
+}
+
+// Script games generate a new board every time they are loaded. Compiled
+// scripts are cached so this only costs the game's init() call.
+void GraphicsView::reloadGame()
+{
+    if (d.scene && !d.file.isEmpty())
+        load(d.file, d.scene->teamNames());
+}
+
+void GraphicsView::cancelLoad()
+{
+    // The job holds its own reference and finishes on its own
+    if (d.loadProgress)
+        d.loadProgress->cancel();
+    d.loadProgress.clear();
+    hideLoadProgress();
+}
+
+void GraphicsView::hideLoadProgress()
+{
+    d.progressTimer.stop();
+    d.progressBar->hide();
+    d.cancelLoadAction->setEnabled(false);
+}
+
+void GraphicsView::updateLoadProgress()
+{
+    const int progress = (d.loadProgress ? d.loadProgress->progress() : -1);
+    if (progress < 0) {
+        d.progressBar->setRange(0, 0);
+    } else {
+        d.progressBar->setRange(0, 100);
+        d.progressBar->setValue(progress);
+    }
+}
+
+void GraphicsView::onGameLoaded()
+{
+    if (!d.loadProgress)
+        return;
+    d.loadProgress.clear();
+    hideLoadProgress();
+
+    const GameLoadResult result = d.loadWatcher.result();
+    if (!result.ok) {
+        qWarning("%s", qPrintable(result.error));
+        QMessageBox::warning(this, tr("Can't load game"), result.error);
+        return;
+    }
     GraphicsScene *scene = new GraphicsScene(this);
-    if (scene->load(fileName, players)) {
-        setBackgroundBrush(QBrush());
-        delete d.scene;
-        d.scene = scene;
-        d.scene->setSceneRect(rect());
-        setScene(scene);
+    // Attached before setGame() so the journal sees the game start
+    if (d.journal.isOpen())
+        d.journal.attach(scene->model());
+    if (scene->setGame(result.game, d.loadPlayers)) {
+        // The current game stays up until the new one has pre-warmed its
+        // faces and laid itself out
+        delete d.pendingScene;
+        d.pendingScene = scene;
+        d.pendingFile = d.loadFile;
+        // --seed=N brings a generated board back
+        d.pendingTitle = QFileInfo(d.loadFile).fileName();
+        if (result.game.generated)
+            d.pendingTitle += tr(" (seed %1)").arg(result.game.seed);
+        connect(scene, SIGNAL(layoutApplied()), this, SLOT(onSceneReady()));
+        scene->setSceneRect(rect());
+        if (!scene->isLayoutPending())
+            onSceneReady();
     } else {
         delete scene;
+        if (d.journal.isOpen() && d.scene)
+            d.journal.attach(d.scene->model());
     }
 }
 
+void GraphicsView::onSceneReady()
+{
+    GraphicsScene *scene = d.pendingScene;
+    if (!scene)
+        return;
+    disconnect(scene, SIGNAL(layoutApplied()), this, SLOT(onSceneReady()));
+    d.pendingScene = 0;
+    d.file = d.pendingFile;
+    window()->setWindowTitle(d.pendingTitle);
+    d.reloadAction->setEnabled(true);
+    setBackgroundBrush(QBrush());
+    delete d.scene;
+    d.scene = scene;
+    connect(scene, SIGNAL(gameFinished()), this, SLOT(onGameFinished()));
+    setScene(scene);
+    d.scene->setSceneRect(rect());
+}
+
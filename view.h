@@ -2,6 +2,9 @@
 #define GRAPHICSVIEW_H
 
 #include <QtGui>
+#include "gameloader.h"
+#include "journal.h"
+
 class GraphicsView;
 class MainWindow : public QMainWindow
 {
@@ -18,20 +21,52 @@ private:
     } d;
 };
 class GraphicsScene;
+struct GameLoadResult
+{
+    GameLoadResult() : ok(false) {}
+
+    GameData game;
+    QString error;
+    bool ok;
+};
+
 class GraphicsView : public QGraphicsView
 {
     Q_OBJECT
 public:
     GraphicsView(QWidget *parent = 0);
+    ~GraphicsView();
     void resizeEvent(QResizeEvent *);
+    void paintEvent(QPaintEvent *);
+    void drawForeground(QPainter *painter, const QRectF &rect);
     QSize sizeHint() const;
     void load(const QString &file, const QStringList &players = QStringList());
 public slots:
     void newGame();
     void createGame();
+    void reloadGame();
+    void cancelLoad();
+private slots:
+    void onGameLoaded();
+    void updateLoadProgress();
+    void onSceneReady();
+    void onGameFinished();
 private:
+    void hideLoadProgress();
+
     struct Data {
-        GraphicsScene *scene;
+        GraphicsScene *scene, *pendingScene;
+
+        QFutureWatcher<GameLoadResult> loadWatcher;
+        QSharedPointer<LoadProgress> loadProgress;
+        QStringList loadPlayers;
+        QString loadFile, pendingFile, file;
+        QString pendingTitle;
+        QProgressBar *progressBar;
+        QTimer progressTimer;
+        QAction *reloadAction, *cancelLoadAction;
+        // One for every game played in this window, see --journal
+        Journal journal;
     } d;
 };
 